@@ -0,0 +1,476 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "analyzer.h"
+#include "args.h"
+#include "jobserver.h"
+#include "process.h"
+#include "trace.h"
+#include "util.h"
+
+/*
+ * Options that cppcheck takes as the compiler does
+ */
+static int is_cppcheck_option(char const *arg)
+{
+	return strncmp(arg, "-I", 2u) == 0 || strncmp(arg, "-D", 2u) == 0 ||
+	    strncmp(arg, "-U", 2u) == 0;
+}
+
+/*
+ * Translates the compiler command line, argv[0] being the compiler, for
+ * an analyzer of the given style.  cppcheck gets the include paths and
+ * macros, clang-tidy the sources followed by -- and the compiler options
+ * without those naming what the compile writes.  The vector is one
+ * allocation to free.
+ */
+char **analyzer_args(char *program, enum analyzer_style style, int argc,
+		     char *argv[])
+{
+	char **vec;
+	int n = 1;
+	int i;
+
+	if (ANALYZER_LINT == style)
+		return lint_args(program, argc, argv);
+	vec = (char **)xmalloc(sizeof(char *) * (size_t)(2 * argc + 2));
+	vec[0] = program;
+	if (ANALYZER_TIDY == style) {
+		for (i = 1; i < argc; ++i)
+			if (is_source_file(argv[i]))
+				vec[n++] = argv[i];
+		vec[n++] = "--";
+	}
+	for (i = 1; i < argc; ++i) {
+		char *const arg = argv[i];
+		int const arity = output_option_arity(arg);
+
+		if (arity != 0) {
+			i += arity - 1;
+		} else if (ANALYZER_TIDY == style) {
+			if (!is_source_file(arg))
+				vec[n++] = arg;
+		} else if (strcmp(arg, "-isystem") == 0 && i + 1 < argc) {
+			vec[n++] = "-I";
+			vec[n++] = argv[++i];
+		} else if (is_cppcheck_option(arg)) {
+			vec[n++] = arg;
+			if ('\0' == arg[2] && i + 1 < argc)
+				vec[n++] = argv[++i];
+		}
+	}
+	if (ANALYZER_CPPCHECK == style)
+		for (i = 1; i < argc; ++i)
+			if (is_source_file(argv[i]))
+				vec[n++] = argv[i];
+	vec[n] = NULL;
+	return vec;
+}
+
+static struct {
+	char const *name;
+	enum analyzer_style style;
+} const styles[] = {
+	{ "cppcheck", ANALYZER_CPPCHECK },
+	{ "lint", ANALYZER_LINT },
+	{ "tidy", ANALYZER_TIDY }
+};
+
+static int parse_style(char const *name, size_t len,
+		       enum analyzer_style *style)
+{
+	size_t i;
+
+	for (i = 0; i != sizeof(styles) / sizeof(styles[0]); ++i)
+		if (strlen(styles[i].name) == len &&
+		    strncmp(styles[i].name, name, len) == 0) {
+			*style = styles[i].style;
+			return 1;
+		}
+	return 0;
+}
+
+/*
+ * One program[:style[:jobs]] entry of len characters
+ */
+static int parse_analyzer(char const *entry, size_t len, struct analyzer *a)
+{
+	char const *const end = &entry[len];
+	char const *colon = memchr(entry, ':', len);
+	char *program;
+
+	a->style = ANALYZER_LINT;
+	a->jobs = 0;
+	if (colon != NULL) {
+		char const *const style = colon + 1;
+		char const *jobs = memchr(style, ':', (size_t)(end - style));
+
+		if (NULL == jobs)
+			jobs = end;
+		if (jobs != style &&
+		    !parse_style(style, (size_t)(jobs - style), &a->style))
+			return 0;
+		if (jobs != end) {
+			char *stop;
+			long const n = strtol(jobs + 1, &stop, 10);
+
+			if (stop != end || n < 0 || n > 1024)
+				return 0;
+			a->jobs = (int)n;
+		}
+		len = (size_t)(colon - entry);
+	}
+	if (0 == len)
+		return 0;
+	program = (char *)xmalloc(len + 1u);
+	memcpy(program, entry, len);
+	program[len] = '\0';
+	a->program = program;
+	return 1;
+}
+
+/*
+ * Fills list, at most MAX_ANALYZERS long, and returns how many analyzers
+ * spec names.  Entries that do not parse are reported and left out.
+ */
+int parse_analyzers(char const *spec, struct analyzer *list)
+{
+	int count = 0;
+
+	while (*spec != '\0') {
+		size_t const len = strcspn(spec, " \t,");
+
+		if (len != 0 && MAX_ANALYZERS == count) {
+			fputs(TOOL_NAME ": LCI_ANALYZERS: too many analyzers\n",
+			      stderr);
+			break;
+		}
+		if (len != 0 && !parse_analyzer(spec, len, &list[count]))
+			fprintf(stderr, TOOL_NAME ": LCI_ANALYZERS: bad entry "
+				"%.*s\n", (int)len, spec);
+		else if (len != 0)
+			++count;
+		spec += len;
+		if (*spec != '\0')
+			++spec;
+	}
+	return count;
+}
+
+/*
+ * The analyzers of LCI_ANALYZERS, which trace accounts as lint
+ */
+int analyzers_configured(struct analyzer *list)
+{
+	char const *const spec = getenv("LCI_ANALYZERS");
+	int count;
+	int i;
+
+	if (NULL == spec)
+		return 0;
+	count = parse_analyzers(spec, list);
+	for (i = 0; i != count; ++i)
+		trace_lint_program(list[i].program);
+	return count;
+}
+
+enum analyzer_policy analyzer_policy(void)
+{
+	char const *const policy = getenv("LCI_ANALYZER_POLICY");
+
+	if (NULL == policy || '\0' == *policy ||
+	    strcmp(policy, "worst") == 0)
+		return POLICY_WORST;
+	if (strcmp(policy, "first") == 0)
+		return POLICY_FIRST;
+	if (strcmp(policy, "all") == 0)
+		return POLICY_ALL;
+	log_printf(LCI_SEV_WARNING, ("unknown LCI_ANALYZER_POLICY %s\n",
+		   policy));
+	return POLICY_WORST;
+}
+
+/*
+ * worst is the highest exit code, all the lowest, so a run fails only
+ * when every analyzer failed
+ */
+int combine_exit_codes(enum analyzer_policy policy, int const *codes,
+		       int count)
+{
+	int code;
+	int i;
+
+	if (0 == count)
+		return EXIT_SUCCESS;
+	code = codes[0];
+	if (POLICY_FIRST == policy)
+		return code;
+	for (i = 1; i < count; ++i)
+		if (POLICY_WORST == policy ? codes[i] > code : codes[i] < code)
+			code = codes[i];
+	return code;
+}
+
+static int lock_slot(char const *dir, char const *name, int slot, int wait)
+{
+	char *const file = (char *)xmalloc(strlen(name) + sizeof(".1234.lock"));
+	char *path;
+	int locked;
+	int fd;
+
+	(void)sprintf(file, "%s.%d.lock", name, slot);
+	path = xjoin_path(dir, file);
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+	free(path);
+	free(file);
+	if (-1 == fd)
+		return -1;
+	do
+		locked = flock(fd, wait ? LOCK_EX : LOCK_EX | LOCK_NB);
+	while (locked != 0 && EINTR == errno);
+	if (0 == locked)
+		return fd;
+	(void)close(fd);
+	return -1;
+}
+
+/*
+ * The run of an analyzer with jobs set holds one of jobs lock files, in
+ * the private directory of the user.  With wait set and every slot busy
+ * it waits for the slot its pid picks, so runs that wait are spread over
+ * the slots.  -1 when none is free, or when waiting for one fails.
+ */
+static int take_slot(struct analyzer const *a, int wait)
+{
+	char const *slash = strrchr(a->program, '/');
+	char const *const name = (NULL == slash) ? a->program : slash + 1;
+	char *const dir = user_tmp_dir();
+	int fd = -1;
+	int i;
+
+	if (NULL == dir)
+		return -1;
+	for (i = 0; i != a->jobs && -1 == fd; ++i)
+		fd = lock_slot(dir, name, i, 0);
+	if (-1 == fd && wait && a->jobs > 0)
+		fd = lock_slot(dir, name, (int)(getpid() % a->jobs), 1);
+	free(dir);
+	return fd;
+}
+
+/*
+ * An unlinked file in TMPDIR that an analyzer writes to
+ */
+static int capture_file(void)
+{
+	char const *tmpdir = getenv("TMPDIR");
+	char *path;
+	int fd;
+
+	if (NULL == tmpdir || '\0' == *tmpdir)
+		tmpdir = "/tmp";
+	path = xjoin_path(tmpdir, "lci-analyzer.XXXXXX");
+	fd = mkstemp(path);
+	if (fd != -1)
+		(void)unlink(path);
+	else
+		perror(TOOL_NAME ": mkstemp");
+	free(path);
+	return fd;
+}
+
+static void copy_capture(int fd, int to_fd)
+{
+	char buf[8192];
+	ssize_t n;
+
+	if (-1 == fd || lseek(fd, 0, SEEK_SET) != 0)
+		return;
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		char const *p = buf;
+
+		if (n < 0 && EINTR == errno)
+			continue;
+		if (n < 0)
+			break;
+		while (n > 0) {
+			ssize_t const w = write(to_fd, p, (size_t)n);
+
+			if (w < 0 && errno != EINTR)
+				return;
+			if (w > 0) {
+				p += w;
+				n -= w;
+			}
+		}
+	}
+}
+
+static int exit_code_of(int status)
+{
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status);
+	if (WIFSIGNALED(status))
+		return WTERMSIG(status);
+	return EXIT_FAILURE;
+}
+
+/*
+ * js is a copy of the jobserver of lci holding the token of the run, if
+ * it took one
+ */
+struct analyzer_run {
+	char **argv;
+	pid_t pid;
+	int running;
+	int slot;
+	int out_fd;
+	int err_fd;
+	struct jobserver js;
+};
+
+static void start_analyzer(struct analyzer_run *run)
+{
+	run->out_fd = capture_file();
+	run->err_fd = capture_file();
+	run->pid = start_child(&run->argv[0], run->out_fd, run->err_fd);
+	run->running = 1;
+}
+
+static int finish_analyzer(struct analyzer const *a, struct analyzer_run *run)
+{
+	int const code = exit_code_of(wait_child(run->pid));
+
+	run->running = 0;
+	if (run->slot != -1)
+		(void)close(run->slot);
+	run->slot = -1;
+	jobserver_release(&run->js);
+	log_printf(LCI_SEV_DEBUG, ("%s exited with %d\n", a->program, code));
+	return code;
+}
+
+/*
+ * Waits for the running analyzers, each slot is given back as soon as
+ * its analyzer exits, not when the ones before it in the list do
+ */
+static void finish_running(struct analyzer const *list,
+			   struct analyzer_run *runs, int count, int *codes)
+{
+	int running = 0;
+	int i;
+
+	for (i = 0; i != count; ++i)
+		running += runs[i].running;
+	while (running != 0) {
+		siginfo_t info;
+		int done = -1;
+
+		memset(&info, 0, sizeof(info));
+		if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) != 0 &&
+		    EINTR == errno)
+			continue;
+		for (i = 0; i != count; ++i)
+			if (runs[i].running && runs[i].pid == info.si_pid)
+				done = i;
+		/*
+		 * some other child of lci, the analyzers are waited for in
+		 * turn
+		 */
+		for (i = 0; -1 == done; ++i)
+			if (runs[i].running)
+				done = i;
+		codes[done] = finish_analyzer(&list[done], &runs[done]);
+		--running;
+	}
+}
+
+/*
+ * Runs the analyzers on the translation unit of the compiler command
+ * line, argv[0] being the compiler, and returns their combined exit
+ * code.  Analyzers with a free slot are started first, the first in the
+ * job slot of lci and each other one with a make jobserver token.  The
+ * others wait for their slot one at a time once no run holds a slot or a
+ * token, so concurrent lci never wait for each other in a cycle.
+ */
+int run_analyzers(struct analyzer const *list, int count, int argc,
+		  char *argv[])
+{
+	struct analyzer_run runs[MAX_ANALYZERS];
+	int codes[MAX_ANALYZERS];
+	struct jobserver js;
+	int started = 0;
+	int i;
+
+	jobserver_open(&js);
+	for (i = 0; i != count; ++i) {
+		runs[i].argv = analyzer_args(list[i].program, list[i].style,
+					     argc, argv);
+		runs[i].pid = -1;
+		runs[i].running = 0;
+		runs[i].slot = -1;
+		runs[i].out_fd = runs[i].err_fd = -1;
+		runs[i].js = js;
+		if (list[i].jobs != 0)
+			runs[i].slot = take_slot(&list[i], 0);
+		if (list[i].jobs != 0 && -1 == runs[i].slot)
+			continue;
+		if (0 == started || jobserver_try_acquire(&runs[i].js)) {
+			start_analyzer(&runs[i]);
+			++started;
+		} else if (runs[i].slot != -1) {
+			(void)close(runs[i].slot);
+			runs[i].slot = -1;
+		}
+	}
+	(void)fflush(NULL);
+	finish_running(list, runs, count, codes);
+	for (i = 0; i != count; ++i)
+		if (-1 == runs[i].pid) {
+			runs[i].slot = take_slot(&list[i], 1);
+			start_analyzer(&runs[i]);
+			codes[i] = finish_analyzer(&list[i], &runs[i]);
+		}
+	for (i = 0; i != count; ++i) {
+		copy_capture(runs[i].out_fd, STDOUT_FILENO);
+		copy_capture(runs[i].err_fd, STDERR_FILENO);
+		if (runs[i].out_fd != -1)
+			(void)close(runs[i].out_fd);
+		if (runs[i].err_fd != -1)
+			(void)close(runs[i].err_fd);
+		free(runs[i].argv);
+	}
+	jobserver_close(&js);
+	return combine_exit_codes(analyzer_policy(), codes, count);
+}
@@ -0,0 +1,67 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_ANALYZER_H_
+#define LCI_INC_ANALYZER_H_
+#else
+#error "LCI_INC_ANALYZER_H_"
+#endif
+
+/*
+ * More than one analyzer.  LCI_ANALYZERS lists, separated by white space
+ * or commas, the analyzers to run instead of lint as program[:style[:jobs]],
+ * style being lint (the default), cppcheck or tidy, see analyzer_args, and
+ * jobs the most runs of that analyzer at a time over all lci processes.
+ * They start together after the compile, the output of each is written as
+ * one block, in list order.  LCI_ANALYZER_POLICY combines their exit codes:
+ * worst (the default) fails when any analyzer fails, first takes the code
+ * of the first analyzer, all fails only when every analyzer fails.
+ */
+
+#define MAX_ANALYZERS 8
+
+/*
+ * How an analyzer wants the compiler options
+ */
+enum analyzer_style {
+	ANALYZER_LINT,		/* PC-lint options, as lint_args */
+	ANALYZER_CPPCHECK,	/* -I, -D and -U, then the sources */
+	ANALYZER_TIDY		/* the sources, then -- and the options */
+};
+
+struct analyzer {
+	char *program;
+	enum analyzer_style style;
+	int jobs;		/*!< 0 for no limit */
+};
+
+enum analyzer_policy {
+	POLICY_WORST,
+	POLICY_FIRST,
+	POLICY_ALL
+};
+
+extern char **analyzer_args(char *program, enum analyzer_style style,
+			    int argc, char *argv[]);
+extern int parse_analyzers(char const *spec, struct analyzer *list);
+extern int analyzers_configured(struct analyzer *list);
+extern enum analyzer_policy analyzer_policy(void);
+extern int combine_exit_codes(enum analyzer_policy policy, int const *codes,
+			      int count);
+extern int run_analyzers(struct analyzer const *list, int count, int argc,
+			 char *argv[]);
@@ -0,0 +1,611 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "util.h"
+
+/*
+ * Whether the program path names one of the compilers in the white space
+ * or colon separated list of program names
+ */
+int is_compiler_name(char const *path, char const *list)
+{
+	char const *slash = strrchr(path, '/');
+	char const *bname = (NULL == slash) ? path : slash + 1;
+	size_t const len = strlen(bname);
+
+	while (*list != '\0') {
+		size_t const n = strcspn(list, " \t:");
+
+		if (n == len && strncmp(list, bname, n) == 0)
+			return 1;
+		list += n;
+		if (*list != '\0')
+			++list;
+	}
+	return 0;
+}
+
+int is_source_file(char const *arg)
+{
+	static char const *const suffixes[] = {
+		".c", ".C", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".CPP",
+		".i", ".ii", NULL
+	};
+	char const *dot = strrchr(arg, '.');
+	int i;
+
+	if ('-' == arg[0] || NULL == dot)
+		return 0;
+	for (i = 0; suffixes[i] != NULL; ++i)
+		if (strcmp(dot, suffixes[i]) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ * Options naming what a single compile writes, they differ between
+ * translation units.  Returns how many arguments the option occupies,
+ * 0 for other arguments.
+ */
+int output_option_arity(char const *arg)
+{
+	if ('-' != arg[0])
+		return 0;
+	if (strcmp(arg, "-c") == 0 || strcmp(arg, "-MD") == 0 ||
+	    strcmp(arg, "-MMD") == 0)
+		return 1;
+	if (strcmp(arg, "-o") == 0 || strcmp(arg, "-MF") == 0 ||
+	    strcmp(arg, "-MT") == 0 || strcmp(arg, "-MQ") == 0)
+		return 2;
+	if (strncmp(arg, "-o", 2u) == 0)
+		return 1;
+	return 0;
+}
+
+/*
+ * The compiler command with its output and dependency file options
+ * removed and -E added, so that it writes the translation unit to stdout
+ */
+char **preprocessor_args(char *argv[])
+{
+	char **pp;
+	int n;
+	int i;
+	int j;
+
+	for (n = 0; argv[n] != NULL; ++n) ;
+	pp = (char **)xmalloc(sizeof(char *) * (size_t)(n + 2));
+	pp[0] = argv[0];
+	for (i = j = 1; i < n; ++i) {
+		int const arity = output_option_arity(argv[i]);
+		if (arity != 0) {
+			i += arity - 1;
+			continue;
+		}
+		pp[j++] = argv[i];
+	}
+	pp[j++] = "-E";
+	pp[j] = NULL;
+	return pp;
+}
+
+/*
+ * path with its suffix replaced, in the current directory when
+ * basename_only is set
+ */
+static char *with_suffix(char const *path, int basename_only,
+			 char const *suffix)
+{
+	char const *slash = strrchr(path, '/');
+	char const *dot;
+	size_t len;
+	char *name;
+
+	if (basename_only && slash != NULL)
+		path = slash + 1;
+	slash = strrchr(path, '/');
+	dot = strrchr(path, '.');
+	len = (dot != NULL && (NULL == slash || dot > slash)) ?
+	    (size_t)(dot - path) : strlen(path);
+	name = (char *)xmalloc(len + strlen(suffix) + 1u);
+	memcpy(name, path, len);
+	(void)strcpy(&name[len], suffix);
+	return name;
+}
+
+/*
+ * The dependency file the compiler writes with -MD, NULL without one or
+ * when it leaves out system headers.  *given is set when the command line
+ * already asks for a dependency file in some way, another one can then
+ * not be added.
+ */
+char *dependency_file(char *argv[], int *given)
+{
+	char const *mf = NULL;
+	char const *out = NULL;
+	char const *source = NULL;
+	int md = 0;
+	int mmd = 0;
+	int i;
+
+	*given = 0;
+	for (i = 1; argv[i] != NULL; ++i) {
+		char const *arg = argv[i];
+
+		if (strcmp(arg, "-MD") == 0)
+			md = 1;
+		else if (strcmp(arg, "-MMD") == 0)
+			mmd = 1;
+		else if (strncmp(arg, "-Wp,", 4u) == 0 &&
+			 strstr(arg, "-M") != NULL)
+			mmd = 1;
+		else if (strcmp(arg, "-MF") == 0 && argv[i + 1] != NULL)
+			mf = argv[++i];
+		else if (strncmp(arg, "-MF", 3u) == 0 && arg[3] != '\0')
+			mf = &arg[3];
+		else if (strcmp(arg, "-o") == 0 && argv[i + 1] != NULL)
+			out = argv[++i];
+		else if (strncmp(arg, "-o", 2u) == 0)
+			out = &arg[2];
+		else if (NULL == source && is_source_file(arg))
+			source = arg;
+	}
+	*given = md || mmd;
+	if (!md || mmd)
+		return NULL;
+	if (mf != NULL)
+		return xstrdup(mf);
+	if (out != NULL)
+		return with_suffix(out, 0, ".d");
+	return (source != NULL) ? with_suffix(source, 1, ".d") : NULL;
+}
+
+enum flag_effect {
+	FLAG_NO_COMPILE = 1,
+	FLAG_SEPARATE_ARG = 2,
+	FLAG_LANGUAGE = 4
+};
+
+struct flag {
+	char const *name;
+	int effect;
+};
+
+/*
+ * Sorted by strcmp for bsearch, only the exact spelling of a flag is found
+ * so -DX and -ofile are never mistaken for -D and -o
+ */
+static struct flag const flags[] = {
+	{ "-###", FLAG_NO_COMPILE },
+	{ "--help", FLAG_NO_COMPILE },
+	{ "--param", FLAG_SEPARATE_ARG },
+	{ "--version", FLAG_NO_COMPILE },
+	{ "-D", FLAG_SEPARATE_ARG },
+	{ "-E", FLAG_NO_COMPILE },
+	{ "-I", FLAG_SEPARATE_ARG },
+	{ "-L", FLAG_SEPARATE_ARG },
+	{ "-M", FLAG_NO_COMPILE },
+	{ "-MF", FLAG_SEPARATE_ARG },
+	{ "-MM", FLAG_NO_COMPILE },
+	{ "-MQ", FLAG_SEPARATE_ARG },
+	{ "-MT", FLAG_SEPARATE_ARG },
+	{ "-S", FLAG_NO_COMPILE },
+	{ "-T", FLAG_SEPARATE_ARG },
+	{ "-U", FLAG_SEPARATE_ARG },
+	{ "-Xassembler", FLAG_SEPARATE_ARG },
+	{ "-Xclang", FLAG_SEPARATE_ARG },
+	{ "-Xlinker", FLAG_SEPARATE_ARG },
+	{ "-Xpreprocessor", FLAG_SEPARATE_ARG },
+	{ "-arch", FLAG_SEPARATE_ARG },
+	{ "-aux-info", FLAG_SEPARATE_ARG },
+	{ "-dumpfullversion", FLAG_NO_COMPILE },
+	{ "-dumpmachine", FLAG_NO_COMPILE },
+	{ "-dumpspecs", FLAG_NO_COMPILE },
+	{ "-dumpversion", FLAG_NO_COMPILE },
+	{ "-e", FLAG_SEPARATE_ARG },
+	{ "-idirafter", FLAG_SEPARATE_ARG },
+	{ "-imacros", FLAG_SEPARATE_ARG },
+	{ "-imultilib", FLAG_SEPARATE_ARG },
+	{ "-include", FLAG_SEPARATE_ARG },
+	{ "-iprefix", FLAG_SEPARATE_ARG },
+	{ "-iquote", FLAG_SEPARATE_ARG },
+	{ "-isysroot", FLAG_SEPARATE_ARG },
+	{ "-isystem", FLAG_SEPARATE_ARG },
+	{ "-iwithprefix", FLAG_SEPARATE_ARG },
+	{ "-iwithprefixbefore", FLAG_SEPARATE_ARG },
+	{ "-l", FLAG_SEPARATE_ARG },
+	{ "-o", FLAG_SEPARATE_ARG },
+	{ "-target", FLAG_SEPARATE_ARG },
+	{ "-u", FLAG_SEPARATE_ARG },
+	{ "-x", FLAG_SEPARATE_ARG | FLAG_LANGUAGE },
+	{ "-z", FLAG_SEPARATE_ARG }
+};
+
+static int compare_flag(void const *key, void const *elem)
+{
+	return strcmp((char const *)key, ((struct flag const *)elem)->name);
+}
+
+static int flag_effect(char const *arg)
+{
+	struct flag const *f;
+
+	if (strncmp(arg, "-print-", 7u) == 0)
+		return FLAG_NO_COMPILE;
+	f = (struct flag const *)bsearch(arg, flags,
+					 sizeof(flags) / sizeof(*flags),
+					 sizeof(*flags), compare_flag);
+	return (NULL == f) ? 0 : f->effect;
+}
+
+/*
+ * -1 when the file suffix decides, else if -x names a language lint reads
+ */
+static int language_is_source(char const *lang)
+{
+	if (strcmp(lang, "none") == 0)
+		return -1;
+	return strcmp(lang, "c") == 0 || strcmp(lang, "c++") == 0 ||
+	    strcmp(lang, "cpp-output") == 0 ||
+	    strcmp(lang, "c++-cpp-output") == 0;
+}
+
+static int is_object_file(char const *arg)
+{
+	static char const *const suffixes[] = {
+		".o", ".obj", ".a", ".so", ".lo", NULL
+	};
+	char const *dot = strrchr(arg, '.');
+	int i;
+
+	if (NULL == dot)
+		return 0;
+	for (i = 0; suffixes[i] != NULL; ++i)
+		if (strcmp(dot, suffixes[i]) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ * Test programs of autoconf and CMake compiler checks
+ */
+static int is_probe_file(char const *arg)
+{
+	char const *slash = strrchr(arg, '/');
+	char const *bname = (NULL == slash) ? arg : slash + 1;
+
+	return strncmp(bname, "conftest.", 9u) == 0 ||
+	    strncmp(bname, "CMakeCCompilerId", 16u) == 0 ||
+	    strncmp(bname, "CMakeCXXCompilerId", 18u) == 0 ||
+	    strstr(arg, "CMakeFiles/CMakeTmp/") != NULL ||
+	    strstr(arg, "CMakeFiles/CMakeScratch/") != NULL;
+}
+
+/*
+ * argv[0] is the compiler
+ */
+void classify_compile(struct compile_args *info, int argc, char *argv[])
+{
+	int lang = -1;
+	int i;
+
+	info->sources = 0;
+	info->objects = 0;
+	info->no_compile = 0;
+	info->compile_only = 0;
+	info->probe = 0;
+	for (i = 1; i < argc; ++i) {
+		char const *const arg = argv[i];
+		int source;
+
+		if ('-' == arg[0] && arg[1] != '\0') {
+			int const effect = flag_effect(arg);
+
+			if (effect & FLAG_NO_COMPILE)
+				info->no_compile = 1;
+			if (strcmp(arg, "-c") == 0)
+				info->compile_only = 1;
+			if ((effect & FLAG_SEPARATE_ARG) && i + 1 < argc) {
+				++i;
+				if (effect & FLAG_LANGUAGE)
+					lang = language_is_source(argv[i]);
+			} else if ('x' == arg[1] && arg[2] != '\0') {
+				lang = language_is_source(&arg[2]);
+			}
+			continue;
+		}
+		source = (lang < 0) ? is_source_file(arg) : lang;
+		if (source)
+			++info->sources;
+		else if (is_object_file(arg))
+			++info->objects;
+		if (is_probe_file(arg))
+			info->probe = 1;
+	}
+}
+
+enum lint_map_kind {
+	MAP_FLAG,
+	MAP_ARG
+};
+
+/*
+ * A compiler flag and the lint options it becomes, for MAP_ARG flags the
+ * lint options are formats of the flag argument
+ */
+struct lint_map {
+	char const *name;
+	int kind;
+	char const *lint[2];
+};
+
+/*
+ * PC-lint spellings, sorted by strcmp for bsearch.  Flags not in the table
+ * are of no interest to lint and dropped.
+ */
+static struct lint_map const lint_maps[] = {
+	{ "-D", MAP_ARG, { "-d%s", NULL } },
+	{ "-I", MAP_ARG, { "-i%s", NULL } },
+	{ "-U", MAP_ARG, { "-u%s", NULL } },
+	{ "-ansi", MAP_FLAG, { "-A(C90)", NULL } },
+	{ "-fsigned-char", MAP_FLAG, { "-fcu", NULL } },
+	{ "-funsigned-char", MAP_FLAG, { "+fcu", NULL } },
+	{ "-idirafter", MAP_ARG, { "-i%s", NULL } },
+	{ "-imacros", MAP_ARG, { "-header(%s)", NULL } },
+	{ "-include", MAP_ARG, { "-header(%s)", NULL } },
+	{ "-iquote", MAP_ARG, { "-i%s", NULL } },
+	{ "-isystem", MAP_ARG, { "-i%s", "+libdir(%s)" } },
+	{ "-m32", MAP_FLAG, { "-sl4", "-sp4" } },
+	{ "-m64", MAP_FLAG, { "-sl8", "-sp8" } },
+	{ "-mx32", MAP_FLAG, { "-sl4", "-sp4" } },
+	{ "-std=c++03", MAP_FLAG, { "-A(C++2003)", NULL } },
+	{ "-std=c++11", MAP_FLAG, { "-A(C++2011)", NULL } },
+	{ "-std=c++14", MAP_FLAG, { "-A(C++2014)", NULL } },
+	{ "-std=c++17", MAP_FLAG, { "-A(C++2017)", NULL } },
+	{ "-std=c++1z", MAP_FLAG, { "-A(C++2017)", NULL } },
+	{ "-std=c++20", MAP_FLAG, { "-A(C++2020)", NULL } },
+	{ "-std=c++23", MAP_FLAG, { "-A(C++2023)", NULL } },
+	{ "-std=c++2a", MAP_FLAG, { "-A(C++2020)", NULL } },
+	{ "-std=c++2b", MAP_FLAG, { "-A(C++2023)", NULL } },
+	{ "-std=c++98", MAP_FLAG, { "-A(C++2003)", NULL } },
+	{ "-std=c11", MAP_FLAG, { "-A(C2011)", NULL } },
+	{ "-std=c17", MAP_FLAG, { "-A(C2018)", NULL } },
+	{ "-std=c18", MAP_FLAG, { "-A(C2018)", NULL } },
+	{ "-std=c23", MAP_FLAG, { "-A(C2023)", NULL } },
+	{ "-std=c2x", MAP_FLAG, { "-A(C2023)", NULL } },
+	{ "-std=c89", MAP_FLAG, { "-A(C90)", NULL } },
+	{ "-std=c90", MAP_FLAG, { "-A(C90)", NULL } },
+	{ "-std=c99", MAP_FLAG, { "-A(C99)", NULL } },
+	{ "-std=gnu++11", MAP_FLAG, { "-A(C++2011)", NULL } },
+	{ "-std=gnu++14", MAP_FLAG, { "-A(C++2014)", NULL } },
+	{ "-std=gnu++17", MAP_FLAG, { "-A(C++2017)", NULL } },
+	{ "-std=gnu++1z", MAP_FLAG, { "-A(C++2017)", NULL } },
+	{ "-std=gnu++20", MAP_FLAG, { "-A(C++2020)", NULL } },
+	{ "-std=gnu++23", MAP_FLAG, { "-A(C++2023)", NULL } },
+	{ "-std=gnu++2a", MAP_FLAG, { "-A(C++2020)", NULL } },
+	{ "-std=gnu++2b", MAP_FLAG, { "-A(C++2023)", NULL } },
+	{ "-std=gnu++98", MAP_FLAG, { "-A(C++2003)", NULL } },
+	{ "-std=gnu11", MAP_FLAG, { "-A(C2011)", NULL } },
+	{ "-std=gnu17", MAP_FLAG, { "-A(C2018)", NULL } },
+	{ "-std=gnu18", MAP_FLAG, { "-A(C2018)", NULL } },
+	{ "-std=gnu23", MAP_FLAG, { "-A(C2023)", NULL } },
+	{ "-std=gnu2x", MAP_FLAG, { "-A(C2023)", NULL } },
+	{ "-std=gnu89", MAP_FLAG, { "-A(C90)", NULL } },
+	{ "-std=gnu90", MAP_FLAG, { "-A(C90)", NULL } },
+	{ "-std=gnu99", MAP_FLAG, { "-A(C99)", NULL } }
+};
+
+/*
+ * Lint options are at most this much longer than the compiler argument
+ */
+#define LINT_TEMPLATE_MAX 16u
+
+static int compare_lint_map(void const *key, void const *elem)
+{
+	return strcmp((char const *)key, ((struct lint_map const *)elem)->name);
+}
+
+static struct lint_map const *find_lint_map(char const *name)
+{
+	return (struct lint_map const *)bsearch(name, lint_maps,
+						sizeof(lint_maps) /
+						sizeof(*lint_maps),
+						sizeof(*lint_maps),
+						compare_lint_map);
+}
+
+/*
+ * The flag of joined forms like -Idir, -DX=1 and -isystemdir, the longest
+ * flag taking an argument that arg starts with
+ */
+static struct lint_map const *find_joined_lint_map(char const *arg)
+{
+	struct lint_map const *found = NULL;
+	size_t i;
+
+	for (i = 0; i != sizeof(lint_maps) / sizeof(*lint_maps); ++i) {
+		struct lint_map const *const m = &lint_maps[i];
+		size_t const len = strlen(m->name);
+
+		if (MAP_ARG == m->kind && strncmp(arg, m->name, len) == 0 &&
+		    arg[len] != '\0' &&
+		    (NULL == found || len > strlen(found->name)))
+			found = m;
+	}
+	return found;
+}
+
+static char *emit(char **slot, char *text, char const *format,
+		  char const *value)
+{
+	*slot = text;
+	(void)sprintf(text, format, value);
+	return text + strlen(text) + 1u;
+}
+
+/*
+ * Translates the compiler command line, argv[0] being the compiler, to a
+ * lint command line with options before source files.  The vector and the
+ * translated options are one allocation to free, source file names point
+ * into argv.
+ */
+char **lint_args(char *lint, int argc, char *argv[])
+{
+	size_t const slots = 2u * (size_t)argc + 2u;
+	size_t bytes = slots * sizeof(char *);
+	size_t nsrc = 0;
+	size_t n = 1;
+	char **vec;
+	char *text;
+	size_t j;
+	int i;
+
+	for (i = 1; i < argc; ++i)
+		bytes += 2u * (strlen(argv[i]) + LINT_TEMPLATE_MAX + 1u);
+	vec = (char **)xmalloc(bytes);
+	text = (char *)&vec[slots];
+	vec[0] = lint;
+	for (i = 1; i < argc; ++i) {
+		char const *const arg = argv[i];
+		char const *value = arg;
+		struct lint_map const *m;
+		int k;
+
+		if ('-' != arg[0] || '\0' == arg[1]) {
+			/*
+			 * sources are parked at the end of the vector
+			 */
+			if (is_source_file(arg))
+				vec[slots - 2u - nsrc++] = argv[i];
+			continue;
+		}
+		m = find_lint_map(arg);
+		if (m != NULL && MAP_ARG == m->kind) {
+			if (i + 1 == argc)
+				continue;
+			value = argv[++i];
+		} else if (NULL == m) {
+			m = find_joined_lint_map(arg);
+			if (m != NULL)
+				value = &arg[strlen(m->name)];
+		}
+		if (NULL == m) {
+			if ((flag_effect(arg) & FLAG_SEPARATE_ARG) &&
+			    i + 1 < argc)
+				++i;
+			continue;
+		}
+		for (k = 0; k != 2 && m->lint[k] != NULL; ++k)
+			text = emit(&vec[n++], text, m->lint[k], value);
+	}
+	for (j = 0; j != nsrc; ++j)
+		vec[n++] = vec[slots - 2u - j];
+	vec[n] = NULL;
+	return vec;
+}
+
+/*
+ * The lint object of a compile of one source with -c, named like its
+ * object file with suffix .lob
+ */
+char *lint_object_file(int argc, char *argv[])
+{
+	struct compile_args info;
+	char const *out = NULL;
+	char const *source = NULL;
+	int i;
+
+	classify_compile(&info, argc, argv);
+	if (info.sources != 1 || !info.compile_only || info.no_compile)
+		return NULL;
+	for (i = 1; i < argc; ++i)
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			out = argv[++i];
+		else if (strncmp(argv[i], "-o", 2u) == 0)
+			out = &argv[i][2];
+		else if (NULL == source && is_source_file(argv[i]))
+			source = argv[i];
+	if (out != NULL)
+		return with_suffix(out, 0, ".lob");
+	return (source != NULL) ? with_suffix(source, 1, ".lob") : NULL;
+}
+
+/*
+ * lint_argv with lint told to write the lint object of the module
+ */
+char **lint_object_output(char *lint_argv[], char const *lob)
+{
+	char **vec;
+	char *opt;
+	int n;
+
+	for (n = 0; lint_argv[n] != NULL; ++n) ;
+	vec = (char **)xmalloc(sizeof(char *) * (size_t)(n + 2) +
+			       strlen(lob) + sizeof("-oo()"));
+	opt = (char *)&vec[n + 2];
+	(void)sprintf(opt, "-oo(%s)", lob);
+	vec[0] = lint_argv[0];
+	vec[1] = opt;
+	memcpy(&vec[2], &lint_argv[1], sizeof(char *) * (size_t)n);
+	return vec;
+}
+
+/*
+ * The global lint pass of a link, lint_argv has the options of the link
+ * and is followed by the lint objects next to the objects linked.
+ * Objects without one, like libraries, are left out.  NULL when there
+ * is no lint object.
+ */
+char **lint_object_args(char *lint_argv[], int argc, char *argv[])
+{
+	char **vec;
+	int lobs = 0;
+	int n;
+	int i;
+
+	for (n = 0; lint_argv[n] != NULL; ++n) ;
+	vec = (char **)xmalloc(sizeof(char *) * (size_t)(n + argc + 1));
+	memcpy(vec, lint_argv, sizeof(char *) * (size_t)n);
+	for (i = 1; i < argc; ++i) {
+		char *lob;
+
+		if ('-' == argv[i][0] || !is_object_file(argv[i]))
+			continue;
+		lob = with_suffix(argv[i], 0, ".lob");
+		if (access(lob, R_OK) == 0) {
+			vec[n + lobs++] = lob;
+		} else {
+			log_printf(LCI_SEV_DEBUG, ("no lint object %s\n", lob));
+			free(lob);
+		}
+	}
+	vec[n + lobs] = NULL;
+	if (0 == lobs) {
+		free(vec);
+		return NULL;
+	}
+	return vec;
+}
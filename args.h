@@ -0,0 +1,51 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_ARGS_H_
+#define LCI_INC_ARGS_H_
+#else
+#error "LCI_INC_ARGS_H_"
+#endif
+
+/*
+ * Knowledge about compiler command lines
+ */
+
+extern int is_compiler_name(char const *path, char const *list);
+extern int is_source_file(char const *arg);
+extern int output_option_arity(char const *arg);
+extern char **preprocessor_args(char *argv[]);
+extern char *dependency_file(char *argv[], int *given);
+
+/*
+ * What a compiler driver does with its command line
+ */
+struct compile_args {
+	int sources;		/* inputs that are compiled */
+	int objects;		/* inputs that are only linked */
+	int no_compile;		/* a mode like -E, -S, -M or --version */
+	int compile_only;	/* -c, nothing is linked */
+	int probe;		/* a configure test program */
+};
+
+extern void classify_compile(struct compile_args *info, int argc,
+			     char *argv[]);
+extern char **lint_args(char *lint, int argc, char *argv[]);
+extern char *lint_object_file(int argc, char *argv[]);
+extern char **lint_object_output(char *lint_argv[], char const *lob);
+extern char **lint_object_args(char *lint_argv[], int argc, char *argv[]);
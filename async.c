@@ -0,0 +1,221 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "async.h"
+#include "util.h"
+
+#define EXIT_SUFFIX ".exit"
+
+/*
+ * The output file of this background lint, NULL in the foreground
+ */
+static char *result_path = NULL;
+
+char const *async_results_path(void)
+{
+	char const *path = getenv("LCI_RESULTS");
+	return (path != NULL && *path != '\0') ? path : NULL;
+}
+
+static void redirect(int fd, int to_fd)
+{
+	if (fd != to_fd && dup2(fd, to_fd) == -1) {
+		perror(TOOL_NAME ": dup2");
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Returns 0 in lci, which is to exit, and 1 in the background process,
+ * which is to lint, -1 when lint cannot be detached.  Names start with
+ * the time, so results are printed in about the order they were started.
+ * The lock is taken before lci exits, so a --wait started after that
+ * waits for this lint.  The result is locked under a dot name that
+ * --wait skips and then renamed, so --wait never reads it unlocked.
+ */
+int async_detach(char const *dir)
+{
+	char name[32];
+	char *temp_path;
+	char *path;
+	int null_fd;
+	int fd;
+	pid_t pid;
+
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+		perror(TOOL_NAME ": LCI_RESULTS");
+		return -1;
+	}
+	(void)sprintf(name, ".%010ld.XXXXXX", (long)time(NULL));
+	temp_path = xjoin_path(dir, name);
+	fd = mkstemp(temp_path);
+	path = xjoin_path(dir, &strrchr(temp_path, '/')[2]);
+	if (-1 == fd || flock(fd, LOCK_EX) != 0 ||
+	    rename(temp_path, path) != 0) {
+		perror(TOOL_NAME ": lint result");
+		if (fd != -1) {
+			(void)close(fd);
+			(void)unlink(temp_path);
+		}
+		free(temp_path);
+		free(path);
+		return -1;
+	}
+	free(temp_path);
+	(void)fflush(NULL);
+	pid = fork();
+	if (pid != 0) {
+		if (-1 == pid) {
+			perror(TOOL_NAME ": fork");
+			(void)unlink(path);
+		}
+		(void)close(fd);
+		free(path);
+		return (-1 == pid) ? -1 : 0;
+	}
+	log_forked();
+	(void)setsid();
+	null_fd = open("/dev/null", O_RDONLY);
+	if (null_fd != -1) {
+		redirect(null_fd, STDIN_FILENO);
+		(void)close(null_fd);
+	}
+	redirect(fd, STDOUT_FILENO);
+	redirect(fd, STDERR_FILENO);
+	(void)close(fd);
+	result_path = path;
+	return 1;
+}
+
+void async_finish(int code)
+{
+	char *exit_path;
+	FILE *f;
+
+	if (NULL == result_path)
+		return;
+	exit_path = (char *)xmalloc(strlen(result_path) +
+				    sizeof(EXIT_SUFFIX));
+	(void)sprintf(exit_path, "%s" EXIT_SUFFIX, result_path);
+	f = fopen(exit_path, "w");
+	if (f != NULL) {
+		fprintf(f, "%d\n", code);
+		(void)fclose(f);
+	}
+	free(exit_path);
+}
+
+static int is_result(struct dirent const *entry)
+{
+	size_t const len = strlen(entry->d_name);
+	size_t const suffix = sizeof(EXIT_SUFFIX) - 1u;
+
+	if ('.' == entry->d_name[0])
+		return 0;
+	return len < suffix ||
+	    strcmp(&entry->d_name[len - suffix], EXIT_SUFFIX) != 0;
+}
+
+/*
+ * Waits for the lock of the result, prints it, returns the exit code of
+ * its lint, EXIT_FAILURE for a lint that was killed before it finished
+ */
+static int report_result(char const *dir, char const *name)
+{
+	char *const path = xjoin_path(dir, name);
+	char *const exit_path = (char *)xmalloc(strlen(path) +
+						sizeof(EXIT_SUFFIX));
+	char buf[4096];
+	int code = EXIT_FAILURE;
+	size_t n;
+	FILE *f;
+
+	(void)sprintf(exit_path, "%s" EXIT_SUFFIX, path);
+	f = fopen(path, "r");
+	if (f != NULL) {
+		while (flock(fileno(f), LOCK_SH) != 0 && EINTR == errno) ;
+		while ((n = fread(buf, 1u, sizeof(buf), f)) != 0)
+			(void)fwrite(buf, 1u, n, stdout);
+		(void)fclose(f);
+		f = fopen(exit_path, "r");
+		if (NULL == f || fscanf(f, "%d", &code) != 1) {
+			fprintf(stderr, TOOL_NAME ": %s: lint did not finish\n",
+				path);
+			code = EXIT_FAILURE;
+		}
+		if (f != NULL)
+			(void)fclose(f);
+	}
+	(void)unlink(exit_path);
+	(void)unlink(path);
+	free(exit_path);
+	free(path);
+	return code;
+}
+
+/*
+ * Results of lints started while waiting are waited for too
+ */
+int async_wait(char const *dir)
+{
+	unsigned long runs = 0;
+	unsigned long failed = 0;
+	int n;
+
+	do {
+		struct dirent **entries;
+		int i;
+
+		n = scandir(dir, &entries, is_result, alphasort);
+		if (-1 == n) {
+			if (ENOENT == errno)
+				break;
+			perror(TOOL_NAME ": LCI_RESULTS");
+			return EXIT_FAILURE;
+		}
+		for (i = 0; i != n; ++i) {
+			if (report_result(dir, entries[i]->d_name) !=
+			    EXIT_SUCCESS)
+				++failed;
+			++runs;
+			free(entries[i]);
+		}
+		free(entries);
+	} while (n != 0);
+	(void)fflush(stdout);
+	fprintf(stderr, TOOL_NAME ": %lu background lint runs, %lu failed\n",
+		runs, failed);
+	return (0 == failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,37 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_ASYNC_H_
+#define LCI_INC_ASYNC_H_
+#else
+#error "LCI_INC_ASYNC_H_"
+#endif
+
+/*
+ * Background lint.  With --async, lci returns the exit code of the
+ * compiler as soon as it is known and lints in a process of its own
+ * session.  The output of each background lint goes to a file in the
+ * results directory named by LCI_RESULTS, locked until lint is done, and
+ * its exit code to the same name with ".exit" added.  lci --wait waits
+ * for the background lints, prints and removes their results.
+ */
+
+extern char const *async_results_path(void);
+extern int async_detach(char const *dir);
+extern void async_finish(int code);
+extern int async_wait(char const *dir);
@@ -0,0 +1,331 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "core.h"
+#include "process.h"
+#include "util.h"
+
+#define BENCH_ARGS 10000
+#define BENCH_ROUNDS 20
+#define BENCH_INVOCATIONS 2000
+#define BENCH_LINT "fake-lint-nt.exe"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * lci options_count lci options in front of a compiler command line, in
+ * all BENCH_ARGS arguments
+ */
+static void fill_command_line(char *argv[], int options_count)
+{
+	static char *const options[] = {
+		"-b", "--no-banner", "-c", "--no-comp", "-f", "--force",
+		"-l", "--no-lint", "-p", "--par", "-q", "--queue-lint"
+	};
+	int i;
+
+	argv[0] = "lci";
+	for (i = 1; i <= options_count; ++i)
+		argv[i] = options[i % (int)(sizeof(options) / sizeof(*options))];
+	argv[i++] = "gcc";
+	for (; i != BENCH_ARGS; ++i)
+		argv[i] = (i & 1) ? "-DX=1" : "-Iinclude";
+	argv[i] = NULL;
+}
+
+static void bench_options(int options_count)
+{
+	static char *orig[BENCH_ARGS + 1];
+	static char *argv[BENCH_ARGS + 1];
+	double best = 1e9;
+	int round;
+
+	fill_command_line(orig, options_count);
+	for (round = 0; round != BENCH_ROUNDS; ++round) {
+		int argc = BENCH_ARGS;
+		double start;
+		double elapsed;
+
+		memcpy(argv, orig, sizeof(argv));
+		start = now();
+		lci_options(&argc, argv);
+		elapsed = now() - start;
+		if (elapsed < best)
+			best = elapsed;
+		if (argc != BENCH_ARGS - options_count) {
+			fputs("lci_bench: options not removed\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	printf("lci_options %5d of %d args %10.1f us\n", options_count,
+	       BENCH_ARGS, best * 1e6);
+}
+
+/*
+ * A synthetic compile, the unit varies so no two are alike
+ */
+struct invocation {
+	char **compile;		/* compiler argv */
+	char **lint;		/* what lci would run as lint */
+	char **wrapped;		/* lci and the compiler argv */
+};
+
+struct slot {
+	pid_t pid;
+	int index;
+	int linting;
+	double start;
+};
+
+struct result {
+	double wall;
+	double *latency;
+	int failed;
+};
+
+static struct invocation *make_invocations(int count, char *lci, int argc,
+					   char *compiler_argv[])
+{
+	struct invocation *const inv =
+	    (struct invocation *)xmalloc(sizeof(*inv) * (size_t)count);
+	int i;
+
+	for (i = 0; i != count; ++i) {
+		char **const argv =
+		    (char **)xmalloc(sizeof(char *) * (size_t)(argc + 8));
+		char *const src = (char *)xmalloc(32u);
+		char *const obj = (char *)xmalloc(32u);
+
+		(void)sprintf(src, "bench/u%d.c", i);
+		(void)sprintf(obj, "bench/u%d.o", i);
+		argv[0] = lci;
+		argv[1] = "--no-banner";
+		memcpy(&argv[2], compiler_argv, sizeof(char *) * (size_t)argc);
+		argv[argc + 2] = "-c";
+		argv[argc + 3] = src;
+		argv[argc + 4] = "-o";
+		argv[argc + 5] = obj;
+		argv[argc + 6] = NULL;
+		inv[i].wrapped = argv;
+		inv[i].compile = &argv[2];
+		inv[i].lint = lint_args(BENCH_LINT, argc + 4, &argv[2]);
+	}
+	return inv;
+}
+
+/*
+ * Output is written, to where it costs nothing more
+ */
+static void start(struct slot *slot, struct invocation const *inv,
+		  int direct, int out_fd)
+{
+	char **const argv = !direct ? inv->wrapped :
+	    slot->linting ? inv->lint : inv->compile;
+
+	slot->pid = start_child(argv, out_fd, -1);
+	if (-1 == slot->pid) {
+		fprintf(stderr, "lci_bench: cannot start %s\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Runs count invocations, jobs at a time, either the compiler and then
+ * lint directly, as lci would, or lci
+ */
+static void replay(struct result *res, struct invocation const *inv,
+		   int count, int jobs, int direct)
+{
+	struct slot *const slots =
+	    (struct slot *)xmalloc(sizeof(*slots) * (size_t)jobs);
+	int const out_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	double const begin = now();
+	int next = 0;
+	int done = 0;
+	int i;
+
+	res->latency = (double *)xmalloc(sizeof(double) * (size_t)count);
+	res->failed = 0;
+	for (i = 0; i != jobs; ++i)
+		slots[i].pid = -1;
+	while (done != count) {
+		int status;
+		pid_t pid;
+
+		for (i = 0; i != jobs && next != count; ++i)
+			if (-1 == slots[i].pid) {
+				slots[i].index = next++;
+				slots[i].linting = 0;
+				slots[i].start = now();
+				start(&slots[i], &inv[slots[i].index], direct,
+				      out_fd);
+			}
+		pid = waitpid(-1, &status, 0);
+		if (-1 == pid) {
+			perror("lci_bench: waitpid");
+			exit(EXIT_FAILURE);
+		}
+		for (i = 0; i != jobs && slots[i].pid != pid; ++i) ;
+		if (i == jobs)
+			continue;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			++res->failed;
+		if (direct && !slots[i].linting) {
+			slots[i].linting = 1;
+			start(&slots[i], &inv[slots[i].index], direct,
+			      out_fd);
+			continue;
+		}
+		res->latency[done++] = now() - slots[i].start;
+		slots[i].pid = -1;
+	}
+	res->wall = now() - begin;
+	(void)close(out_fd);
+	free(slots);
+}
+
+static int compare_double(void const *a, void const *b)
+{
+	double const x = *(double const *)a;
+	double const y = *(double const *)b;
+	return (x > y) - (x < y);
+}
+
+static double mean(struct result const *res, int count)
+{
+	double sum = 0.0;
+	int i;
+
+	for (i = 0; i != count; ++i)
+		sum += res->latency[i];
+	return sum / count;
+}
+
+static void report(char const *name, struct result *res, int count)
+{
+	double const *const lat = res->latency;
+
+	qsort(res->latency, (size_t)count, sizeof(double), compare_double);
+	printf("%-8s %9.1f %8.2f %8.2f %8.2f %8.2f %8.2f", name,
+	       count / res->wall, mean(res, count) * 1e3,
+	       lat[count / 2] * 1e3, lat[count * 90 / 100] * 1e3,
+	       lat[count * 99 / 100] * 1e3, lat[count - 1] * 1e3);
+	if (res->failed != 0)
+		printf("  %d failed", res->failed);
+	putchar('\n');
+}
+
+static void bench_replay(char *lci, int argc, char *compiler_argv[],
+			 int count, int jobs)
+{
+	struct invocation *const inv =
+	    make_invocations(count, lci, argc, compiler_argv);
+	struct result direct;
+	struct result wrapped;
+
+	printf("%d invocations of %s, %d at a time\n", count,
+	       compiler_argv[0], jobs);
+	printf("%-8s %9s %8s %8s %8s %8s %8s\n", "", "inv/s", "mean ms",
+	       "p50", "p90", "p99", "max");
+	replay(&direct, inv, count, jobs, 1);
+	replay(&wrapped, inv, count, jobs, 0);
+	report("direct", &direct, count);
+	report("lci", &wrapped, count);
+	printf("%-8s %9.1f %8.2f\n", "overhead",
+	       count / wrapped.wall - count / direct.wall,
+	       (mean(&wrapped, count) - mean(&direct, count)) * 1e3);
+	free(direct.latency);
+	free(wrapped.latency);
+}
+
+/*
+ * The fake tools next to lci_bench come first in PATH
+ */
+static void use_own_tools(char const *self)
+{
+	char const *const slash = strrchr(self, '/');
+	char const *const path = getenv("PATH");
+	char *value;
+
+	if (NULL == slash)
+		return;
+	value = (char *)xmalloc(strlen(self) + strlen(path ? path : "") + 2u);
+	(void)sprintf(value, "%.*s:%s", (int)(slash - self), self,
+		      path ? path : "");
+	(void)setenv("PATH", value, 1);
+	free(value);
+}
+
+/*
+ * lci_bench [-n count] [-j jobs] [lci [compiler [compiler options]]], by
+ * default ./lci and fake-flint, each invocation compiles and lints a unit
+ * of its own.  FAKE_CPU_MS and the other settings of the fake tools set
+ * the load.
+ */
+int main(int argc, char *argv[])
+{
+	static char *default_compiler[] = { "fake-flint", NULL };
+	int count = BENCH_INVOCATIONS;
+	int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int first = 1;
+
+	for (; first + 1 < argc && '-' == argv[first][0]; first += 2) {
+		if (strcmp(argv[first], "-n") == 0)
+			count = atoi(argv[first + 1]);
+		else if (strcmp(argv[first], "-j") == 0)
+			jobs = atoi(argv[first + 1]);
+		else
+			break;
+	}
+	if (count < 1 || jobs < 1) {
+		fputs("lci_bench: -n and -j take a positive number\n", stderr);
+		return EXIT_FAILURE;
+	}
+	use_own_tools(argv[0]);
+	bench_options(0);
+	bench_options(10);
+	bench_options(1000);
+	bench_options(BENCH_ARGS / 2);
+	if (argc > first + 1)
+		bench_replay(argv[first], argc - first - 1, &argv[first + 1],
+			     count, jobs);
+	else
+		bench_replay((argc > first) ? argv[first] : "./lci", 1,
+			     default_compiler, count, jobs);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of what every lci run does.  JSON for comparing
+ * commits: micro_bench --benchmark_out=f.json --benchmark_out_format=json
+ * or the micro_bench_json target.
+ */
+
+extern "C" {
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core.h"
+#include "util.h"
+}
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <vector>
+
+static void BM_ParseBoolFlag(benchmark::State &state)
+{
+	static char const *const args[] = { "--no-banner", "--no-b", "--nob",
+		"--no-compiler-at-all" };
+	char const *const arg = args[state.range(0)];
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(parse_bool_flag(arg, "--no-banner", 6));
+}
+BENCHMARK(BM_ParseBoolFlag)->DenseRange(0, 3);
+
+static void BM_LciCalledByRealName(benchmark::State &state)
+{
+	static char const *const paths[] = { "lci", "/usr/local/bin/lci",
+		"/usr/bin/gcc", "/opt/tools/lci/bin/" };
+	char const *const path = paths[state.range(0)];
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(lci_called_by_real_name(path));
+}
+BENCHMARK(BM_LciCalledByRealName)->DenseRange(0, 3);
+
+/*
+ * Removes the second of range(0) arguments, the vector is refilled when
+ * half of it is gone, so the sizes measured are range(0) down to half.
+ * The refill costs less than one pointer per iteration.
+ */
+static void BM_RemoveIndex(benchmark::State &state)
+{
+	int const size = (int)state.range(0);
+	std::vector<char *> vec(size + 1, const_cast<char *>("-DX=1"));
+	int count = size;
+
+	vec[size] = NULL;
+	for (auto _ : state) {
+		int offset = 1;
+
+		remove_index(&offset, &count, &vec[0]);
+		if (count == size / 2) {
+			count = size;
+			std::fill(vec.begin(), vec.end() - 1,
+				  const_cast<char *>("-DX=1"));
+		}
+	}
+}
+BENCHMARK(BM_RemoveIndex)->Arg(16)->Arg(256)->Arg(10000);
+
+/*
+ * range(0) lci options in front of a compile of range(1) arguments.  A
+ * copy of the argv pointers is part of every iteration.
+ */
+static void BM_LciOptions(benchmark::State &state)
+{
+	static char const *const options[] = { "-b", "--no-banner", "-f",
+		"--force", "-p", "--par" };
+	static char const *const compile[] = { "-c", "-O2", "-Wall",
+		"-Iinclude", "-DNDEBUG", "-o", "unit.o", "unit.c" };
+	int const options_count = (int)state.range(0);
+	int const args = (int)state.range(1);
+	std::vector<char *> orig;
+	std::vector<char *> argv;
+	int i;
+
+	orig.push_back(const_cast<char *>("lci"));
+	for (i = 0; i != options_count; ++i)
+		orig.push_back(const_cast<char *>(options[i % 6]));
+	orig.push_back(const_cast<char *>("gcc"));
+	for (i = 0; i != args; ++i)
+		orig.push_back(const_cast<char *>(compile[i % 8]));
+	orig.push_back(NULL);
+	argv = orig;
+	for (auto _ : state) {
+		int argc = (int)orig.size() - 1;
+
+		std::copy(orig.begin(), orig.end(), argv.begin());
+		lci_options(&argc, &argv[0]);
+		benchmark::DoNotOptimize(argc);
+	}
+	show_banner = 1;
+	force_lint = 0;
+	parallel_lint = 0;
+}
+BENCHMARK(BM_LciOptions)
+    ->Args({0, 8})->Args({1, 8})->Args({3, 30})
+    ->Args({10, 10000})->Args({1000, 10000})->Args({5000, 5000});
+
+/*
+ * range(0) set logs the record, else it is below the ceiling
+ */
+static void BM_LogPrintf(benchmark::State &state)
+{
+	enum severity const old_severity =
+	    set_severity_ceiling(state.range(0) ? LCI_SEV_DEBUG :
+				 LCI_SEV_NOTICE);
+
+	for (auto _ : state)
+		(void)log_printf(LCI_SEV_DEBUG, ("started %s as %ld\n", "gcc",
+				 12345L));
+	(void)set_severity_ceiling(old_severity);
+}
+BENCHMARK(BM_LogPrintf)->Arg(0)->Arg(1);
+
+/*
+ * Records go to /dev/null, so a logged record costs what it does in lci
+ */
+int main(int argc, char *argv[])
+{
+	(void)setenv("LCI_LOG", "/dev/null", 1);
+	log_begin();
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return EXIT_FAILURE;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,865 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "args.h"
+#include "cache.h"
+#include "hash.h"
+#include "manifest.h"
+#include "process.h"
+#include "trace.h"
+#include "util.h"
+
+#define CACHE_MAGIC "lci-cache 1"
+#define CACHE_SHARDS 16
+#define DEFAULT_CACHE_SIZE (1024UL * 1024UL * 1024UL)
+#define STALE_TMP_SECONDS (60 * 60)
+#define ADDED_NAME ".added"
+#define MANIFEST_SUFFIX ".manifest"
+#define OUTPUT_SUFFIX ".output"
+
+struct cache_file {
+	time_t mtime;
+	unsigned long size;
+	char *path;
+};
+
+static char const *cache_dir(void)
+{
+	char const *dir = getenv("LCI_CACHE_DIR");
+	return (dir != NULL && *dir != '\0') ? dir : NULL;
+}
+
+static int direct_mode(void)
+{
+	return getenv("LCI_NODIRECT") == NULL;
+}
+
+unsigned long parse_size(char const *str)
+{
+	char *end;
+	unsigned long size;
+
+	errno = 0;
+	size = strtoul(str, &end, 10);
+	if (errno != 0 || end == str)
+		return 0;
+	switch (*end) {
+	case 'G':
+	case 'g':
+		size *= 1024UL;
+		/* fall through */
+	case 'M':
+	case 'm':
+		size *= 1024UL;
+		/* fall through */
+	case 'K':
+	case 'k':
+		size *= 1024UL;
+		++end;
+		break;
+	default:
+		break;
+	}
+	return (*end == '\0') ? size : 0;
+}
+
+static unsigned long cache_size_limit(void)
+{
+	char const *str = getenv("LCI_CACHE_SIZE");
+	unsigned long size = 0;
+
+	if (str != NULL)
+		size = parse_size(str);
+	return (size != 0) ? size : DEFAULT_CACHE_SIZE;
+}
+
+static int make_dir(char const *path)
+{
+	if (mkdir(path, 0777) == 0 || EEXIST == errno)
+		return 1;
+	log_printf(LCI_SEV_WARNING, ("cannot create cache directory %s: %s\n",
+		   path, strerror(errno)));
+	return 0;
+}
+
+static int hash_preprocessed(struct hash_state *state, char *compiler_argv[],
+			     struct manifest_scan *scan)
+{
+	char buf[BUFSIZ];
+	char **pp;
+	int fds[2];
+	int null_fd;
+	int status;
+	pid_t cpid;
+	ssize_t n;
+
+	if (pipe(fds) == -1) {
+		perror(TOOL_NAME ": pipe");
+		return 0;
+	}
+	null_fd = open("/dev/null", O_WRONLY);
+	pp = preprocessor_args(compiler_argv);
+	cpid = start_child(pp, fds[1], null_fd);
+	trace_role(cpid, TRACE_PREPROCESSOR);
+	free(pp);
+	(void)close(fds[1]);
+	if (null_fd != -1)
+		(void)close(null_fd);
+	for (;;) {
+		n = read(fds[0], buf, sizeof(buf));
+		if (n > 0) {
+			hash_update(state, buf, (size_t) n);
+			if (scan != NULL)
+				manifest_scan_feed(scan, buf, (size_t) n);
+		} else if (0 == n || errno != EINTR)
+			break;
+	}
+	(void)close(fds[0]);
+	status = wait_child(cpid);
+	if (n < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		log_puts(LCI_SEV_INFORMATIONAL, "cannot preprocess, no cache\n");
+		return 0;
+	}
+	return 1;
+}
+
+static char *find_program(char const *name)
+{
+	char const *dirs = getenv("PATH");
+	char const *end;
+
+	if (strchr(name, '/') != NULL)
+		return xstrdup(name);
+	if (NULL == dirs)
+		dirs = "/usr/bin:/bin";
+	for (;; dirs = end + 1) {
+		struct stat st;
+		char *dir;
+		char *path;
+
+		end = strchr(dirs, ':');
+		if (NULL == end)
+			end = dirs + strlen(dirs);
+		dir = (char *)xmalloc((size_t) (end - dirs) + 2u);
+		if (end == dirs) {
+			(void)strcpy(dir, ".");
+		} else {
+			memcpy(dir, dirs, (size_t) (end - dirs));
+			dir[end - dirs] = '\0';
+		}
+		path = xjoin_path(dir, name);
+		free(dir);
+		if (stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+		    access(path, X_OK) == 0)
+			return path;
+		free(path);
+		if ('\0' == *end)
+			return NULL;
+	}
+}
+
+static int hash_program_identity(struct hash_state *state, char const *name)
+{
+	char buf[64];
+	struct stat st;
+	char *path;
+	int ok;
+
+	path = find_program(name);
+	if (NULL == path)
+		return 0;
+	ok = (stat(path, &st) == 0);
+	if (ok) {
+		hash_string(state, path);
+		(void)sprintf(buf, "%lu %ld", (unsigned long)st.st_size,
+			      (long)st.st_mtime);
+		hash_string(state, buf);
+	}
+	free(path);
+	return ok;
+}
+
+static void copy_stream(FILE * in, FILE * out, unsigned long size)
+{
+	char buf[BUFSIZ];
+
+	while (size != 0) {
+		size_t const want = (size < sizeof(buf)) ? size : sizeof(buf);
+		size_t const got = fread(buf, 1u, want, in);
+		if (0 == got)
+			break;
+		if (fwrite(buf, 1u, got, out) != got)
+			break;
+		size -= got;
+	}
+}
+
+static unsigned long file_size(char const *path)
+{
+	struct stat st;
+	return (stat(path, &st) == 0) ? (unsigned long)st.st_size : 0UL;
+}
+
+static int copy_file(char const *path, FILE * out, unsigned long size)
+{
+	FILE *in = fopen(path, "rb");
+
+	if (NULL == in)
+		return 0;
+	copy_stream(in, out, size);
+	(void)fclose(in);
+	return 1;
+}
+
+static int replay_entry(FILE * entry)
+{
+	char header[128];
+	unsigned long out_size;
+	unsigned long err_size;
+	int code;
+
+	if (fgets(header, (int)sizeof(header), entry) == NULL ||
+	    sscanf(header, CACHE_MAGIC " %d %lu %lu", &code, &out_size,
+		   &err_size) != 3)
+		return -1;
+	copy_stream(entry, stdout, out_size);
+	copy_stream(entry, stderr, err_size);
+	return code;
+}
+
+static char *make_temp(char const *shard, char const *kind, int *fd)
+{
+	char *path = xjoin_path(shard, kind);
+
+	path = (char *)xrealloc(path, strlen(path) + sizeof(".XXXXXX"));
+	(void)strcat(path, ".XXXXXX");
+	*fd = mkstemp(path);
+	if (-1 == *fd) {
+		log_printf(LCI_SEV_WARNING, ("cannot create %s: %s\n", path,
+			   strerror(errno)));
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
+static int compare_mtime(void const *lhs, void const *rhs)
+{
+	time_t const l = ((struct cache_file const *)lhs)->mtime;
+	time_t const r = ((struct cache_file const *)rhs)->mtime;
+	return (l < r) ? -1 : (l > r);
+}
+
+/*
+ * Least recently used eviction within one shard, each shard gets an
+ * equal part of LCI_CACHE_SIZE
+ */
+static void clean_shard(char const *shard)
+{
+	unsigned long const limit = cache_size_limit() / CACHE_SHARDS;
+	struct cache_file *files = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+	unsigned long total = 0;
+	time_t const now = time(NULL);
+	struct dirent *de;
+	DIR *dir;
+	size_t i;
+
+	dir = opendir(shard);
+	if (NULL == dir)
+		return;
+	while ((de = readdir(dir)) != NULL) {
+		struct stat st;
+		char *path;
+
+		if ('.' == de->d_name[0])
+			continue;
+		path = xjoin_path(shard, de->d_name);
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		if (strncmp(de->d_name, "tmp", 3u) == 0) {
+			/*
+			 * leftovers from killed lci processes
+			 */
+			if (now - st.st_mtime > STALE_TMP_SECONDS)
+				(void)unlink(path);
+			free(path);
+			continue;
+		}
+		if (count == capacity) {
+			capacity = (0 == capacity) ? 64u : 2u * capacity;
+			files = (struct cache_file *)xrealloc(files,
+							      capacity *
+							      sizeof(*files));
+		}
+		files[count].mtime = st.st_mtime;
+		files[count].size = (unsigned long)st.st_size;
+		files[count].path = path;
+		total += files[count].size;
+		++count;
+	}
+	(void)closedir(dir);
+	if (total > limit) {
+		unsigned long const target = limit / 10u * 9u;
+		qsort(files, count, sizeof(*files), compare_mtime);
+		for (i = 0; i != count && total > target; ++i) {
+			log_printf(LCI_SEV_DEBUG,
+				   ("evict %s\n", files[i].path));
+			if (unlink(files[i].path) == 0 || ENOENT == errno)
+				total -= files[i].size;
+		}
+	}
+	for (i = 0; i != count; ++i)
+		free(files[i].path);
+	free(files);
+}
+
+/*
+ * A store appends a byte for each KiB it adds to the shard to ADDED_NAME.
+ * The shard is cleaned when that reaches a tenth of its part of
+ * LCI_CACHE_SIZE, what a clean frees, so it stays about within its part
+ * without a scan on every store.
+ */
+static void count_added(char const *shard, unsigned long size)
+{
+	unsigned long const limit = cache_size_limit() / CACHE_SHARDS;
+	char kib[64];
+	size_t n = (size_t)(size / 1024u) + 1u;
+	char *const path = xjoin_path(shard, ADDED_NAME);
+	int const fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+			    0666);
+	struct stat st;
+
+	free(path);
+	if (n > sizeof(kib))
+		n = sizeof(kib);
+	memset(kib, '.', n);
+	if (-1 == fd || write(fd, kib, n) != (ssize_t) n ||
+	    fstat(fd, &st) != 0 ||
+	    (unsigned long)st.st_size * 1024UL >= limit / 10u) {
+		if (fd != -1)
+			(void)ftruncate(fd, 0);
+		clean_shard(shard);
+	}
+	if (fd != -1)
+		(void)close(fd);
+}
+
+static char *shard_of(char const *entry)
+{
+	char *shard = xstrdup(entry);
+	*strrchr(shard, '/') = '\0';
+	return shard;
+}
+
+static void discard_temps(struct lint_cache *cache)
+{
+	if (cache->out_tmp != NULL) {
+		(void)close(cache->out_fd);
+		(void)unlink(cache->out_tmp);
+		free(cache->out_tmp);
+		cache->out_tmp = NULL;
+	}
+	if (cache->err_tmp != NULL) {
+		(void)close(cache->err_fd);
+		(void)unlink(cache->err_tmp);
+		free(cache->err_tmp);
+		cache->err_tmp = NULL;
+	}
+	cache->out_fd = -1;
+	cache->err_fd = -1;
+}
+
+/*
+ * Everything besides the included headers that the preprocessor output
+ * depends on
+ */
+static int hash_direct_inputs(struct hash_state *state, char *compiler_argv[])
+{
+	static char const *const env[] = {
+		"CPATH", "C_INCLUDE_PATH", "CPLUS_INCLUDE_PATH", NULL
+	};
+	char cwd[4096];
+	int sources = 0;
+	int i;
+
+	hash_string(state, "direct");
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+		return 0;
+	hash_string(state, cwd);
+	for (i = 0; env[i] != NULL; ++i) {
+		char const *value = getenv(env[i]);
+		hash_string(state, env[i]);
+		hash_string(state, (value != NULL) ? value : "");
+	}
+	for (i = 1; compiler_argv[i] != NULL; ++i)
+		if (is_source_file(compiler_argv[i])) {
+			if (!hash_file(state, compiler_argv[i]))
+				return 0;
+			++sources;
+		}
+	return sources != 0;
+}
+
+static char *key_path(char const *dir, char const key[HASH_HEX_SIZE],
+		      char const *suffix)
+{
+	char shard_name[2];
+	char *shard;
+	char *path;
+
+	shard_name[0] = key[0];
+	shard_name[1] = '\0';
+	shard = xjoin_path(dir, shard_name);
+	if (!make_dir(dir) || !make_dir(shard)) {
+		free(shard);
+		return NULL;
+	}
+	path = xjoin_path(shard, &key[1]);
+	free(shard);
+	path = (char *)xrealloc(path, strlen(path) + strlen(suffix) + 1u);
+	return strcat(path, suffix);
+}
+
+static void store_manifest(struct lint_cache *cache)
+{
+	char const *name;
+	char *shard;
+	char *tmp;
+	FILE *f;
+	int fd;
+	int ok;
+
+	if (NULL == cache->manifest || NULL == cache->manifest_text)
+		return;
+	shard = shard_of(cache->manifest);
+	tmp = make_temp(shard, "tmp", &fd);
+	free(shard);
+	if (NULL == tmp)
+		return;
+	f = fdopen(fd, "w");
+	ok = (f != NULL);
+	if (ok) {
+		/*
+		 * the result key is the shard name followed by the entry name
+		 */
+		name = strrchr(cache->entry, '/') + 1;
+		ok = (fprintf(f, MANIFEST_MAGIC " %c%s\n%s", name[-2], name,
+			      cache->manifest_text) > 0);
+		ok = (fclose(f) == 0) && ok;
+	} else {
+		(void)close(fd);
+	}
+	if (!(ok && rename(tmp, cache->manifest) == 0)) {
+		log_printf(LCI_SEV_WARNING, ("cannot store %s\n",
+			   cache->manifest));
+		(void)unlink(tmp);
+	}
+	free(tmp);
+}
+
+static char *output_path(struct lint_cache const *cache)
+{
+	char *path = (char *)xmalloc(strlen(cache->entry) +
+				     sizeof(OUTPUT_SUFFIX));
+	return strcat(strcpy(path, cache->entry), OUTPUT_SUFFIX);
+}
+
+/*
+ * Copies the file lint wrote to or from the cache, via a temporary file
+ * renamed into place
+ */
+static int copy_output(char const *from, char const *to)
+{
+	char *tmp;
+	FILE *in;
+	FILE *out;
+	int ok;
+
+	in = fopen(from, "rb");
+	if (NULL == in)
+		return 0;
+	tmp = (char *)xmalloc(strlen(to) + sizeof(".lci-tmp"));
+	(void)strcat(strcpy(tmp, to), ".lci-tmp");
+	out = fopen(tmp, "wb");
+	ok = (out != NULL);
+	if (ok) {
+		copy_stream(in, out, file_size(from));
+		ok = !ferror(in) && !ferror(out);
+		ok = (fclose(out) == 0) && ok;
+		ok = ok && rename(tmp, to) == 0;
+	}
+	if (!ok) {
+		log_printf(LCI_SEV_WARNING,
+			   ("cannot copy %s to %s\n", from, to));
+		(void)unlink(tmp);
+	}
+	(void)fclose(in);
+	free(tmp);
+	return ok;
+}
+
+static int open_entry(struct lint_cache *cache, char const *dir,
+		      char const key[HASH_HEX_SIZE])
+{
+	cache->entry = key_path(dir, key, "");
+	if (NULL == cache->entry)
+		return 0;
+	cache->hit = fopen(cache->entry, "rb");
+	if (NULL == cache->hit)
+		return 0;
+	if (cache->output != NULL) {
+		char *const path = output_path(cache);
+		int const restored = copy_output(path, cache->output);
+
+		free(path);
+		if (!restored) {
+			(void)fclose(cache->hit);
+			cache->hit = NULL;
+			return 0;
+		}
+	}
+	log_printf(LCI_SEV_INFORMATIONAL, ("cache hit %s\n", key));
+	(void)utime(cache->entry, NULL);
+	return 1;
+}
+
+/*
+ * Direct mode, find the result key from the manifest without running the
+ * preprocessor.  The manifest path is kept for storing a new manifest.
+ */
+static int lookup_direct(struct lint_cache *cache, char const *dir,
+			 struct hash_state state, char *compiler_argv[])
+{
+	char key[HASH_HEX_SIZE];
+
+	if (!hash_direct_inputs(&state, compiler_argv))
+		return 0;
+	hash_final_hex(&state, key);
+	log_printf(LCI_SEV_DEBUG, ("direct key %s\n", key));
+	cache->manifest = key_path(dir, key, MANIFEST_SUFFIX);
+	if (NULL == cache->manifest || !manifest_lookup(cache->manifest, key))
+		return 0;
+	if (open_entry(cache, dir, key))
+		return 1;
+	free(cache->entry);
+	cache->entry = NULL;
+	return 0;
+}
+
+/*
+ * argv of the compile with -MD -MF added when no dependency file is asked
+ * for.  compiler_argv is the same command line with response files
+ * expanded.  Only a direct mode cache uses the dependency file.
+ */
+char **lint_cache_depend(struct compile_deps *deps, char *argv[],
+			 char *compiler_argv[])
+{
+	struct compile_args info;
+	char const *tmpdir = getenv("TMPDIR");
+	char **vec;
+	int given;
+	int fd;
+	int n;
+
+	deps->path = NULL;
+	deps->temporary = 0;
+	deps->start = time(NULL);
+	if (NULL == cache_dir() || !direct_mode())
+		return argv;
+	for (n = 0; compiler_argv[n] != NULL; ++n) ;
+	classify_compile(&info, n, compiler_argv);
+	if (info.sources != 1 || info.no_compile || info.probe)
+		return argv;
+	deps->path = dependency_file(compiler_argv, &given);
+	if (given)
+		return argv;
+	if (NULL == tmpdir || '\0' == *tmpdir)
+		tmpdir = "/tmp";
+	deps->path = xjoin_path(tmpdir, "lci-dep.XXXXXX");
+	fd = mkstemp(deps->path);
+	if (-1 == fd) {
+		log_printf(LCI_SEV_WARNING, ("cannot create %s: %s\n",
+			   deps->path, strerror(errno)));
+		free(deps->path);
+		deps->path = NULL;
+		return argv;
+	}
+	(void)close(fd);
+	deps->temporary = 1;
+	for (n = 0; argv[n] != NULL; ++n) ;
+	vec = (char **)xmalloc(sizeof(char *) * (size_t)(n + 4));
+	memcpy(vec, argv, sizeof(char *) * (size_t)n);
+	vec[n] = "-MD";
+	vec[n + 1] = "-MF";
+	vec[n + 2] = deps->path;
+	vec[n + 3] = NULL;
+	return vec;
+}
+
+void lint_cache_depend_end(struct compile_deps *deps)
+{
+	if (deps->temporary)
+		(void)unlink(deps->path);
+	free(deps->path);
+	deps->path = NULL;
+	deps->temporary = 0;
+}
+
+/*
+ * The content hash and path of each file of a manifest, not its size and
+ * times, so a file touched without a change, by a checkout or a clean
+ * rebuild, keeps the key
+ */
+static void hash_manifest_contents(struct hash_state *state, char const *text)
+{
+	while (*text != '\0') {
+		char const *const end = strchr(text, '\n');
+		char const *field = text;
+		int i;
+
+		for (i = 0; i != 3; ++i)
+			field = strchr(field, ' ') + 1;
+		hash_update(state, field, (size_t)(end - field) + 1u);
+		text = end + 1;
+	}
+}
+
+/*
+ * Depend mode, the files of the translation unit come from the dependency
+ * file of the compile and the key is made from their content, no
+ * preprocessor is run
+ */
+static int hash_depend(struct lint_cache *cache, struct hash_state *state,
+		       char *compiler_argv[], struct compile_deps const *deps)
+{
+	struct manifest_scan scan;
+	int ok;
+
+	if (NULL == deps || NULL == deps->path || NULL == cache->manifest ||
+	    !hash_direct_inputs(state, compiler_argv))
+		return 0;
+	manifest_scan_init(&scan);
+	ok = manifest_scan_depfile(&scan, deps->path);
+	if (ok)
+		cache->manifest_text = manifest_scan_render(&scan, deps->start);
+	manifest_scan_free(&scan);
+	if (NULL == cache->manifest_text)
+		return 0;
+	hash_string(state, "depend");
+	hash_manifest_contents(state, cache->manifest_text);
+	log_puts(LCI_SEV_DEBUG, "key from dependency file\n");
+	return 1;
+}
+
+static int hash_preprocessor_output(struct lint_cache *cache,
+				    struct hash_state *state,
+				    char *compiler_argv[])
+{
+	struct manifest_scan scan;
+	time_t const start = time(NULL);
+	int ok;
+
+	manifest_scan_init(&scan);
+	ok = hash_preprocessed(state, compiler_argv,
+			       (cache->manifest != NULL) ? &scan : NULL);
+	if (ok && cache->manifest != NULL)
+		cache->manifest_text = manifest_scan_render(&scan, start);
+	manifest_scan_free(&scan);
+	return ok;
+}
+
+int lint_cache_begin(struct lint_cache *cache, char *compiler_argv[],
+		     char *lint_argv[], struct compile_deps const *deps,
+		     char const *output)
+{
+	struct hash_state state;
+	struct hash_state depend;
+	char key[HASH_HEX_SIZE];
+	char const *dir = cache_dir();
+	char *shard;
+	int i;
+
+	cache->entry = NULL;
+	cache->hit = NULL;
+	cache->manifest = NULL;
+	cache->manifest_text = NULL;
+	cache->output = output;
+	cache->out_tmp = NULL;
+	cache->err_tmp = NULL;
+	cache->out_fd = -1;
+	cache->err_fd = -1;
+	if (NULL == dir || NULL == compiler_argv[0])
+		return 0;
+	hash_init(&state);
+	hash_string(&state, CACHE_MAGIC);
+	for (i = 0; lint_argv[i] != NULL; ++i)
+		hash_string(&state, lint_argv[i]);
+	if (!hash_program_identity(&state, lint_argv[0]))
+		return 0;
+	if (direct_mode() && lookup_direct(cache, dir, state, compiler_argv))
+		return 1;
+
+	depend = state;
+	if (hash_depend(cache, &depend, compiler_argv, deps)) {
+		state = depend;
+	} else if (!hash_preprocessor_output(cache, &state, compiler_argv)) {
+		lint_cache_abort(cache);
+		return 0;
+	}
+	hash_final_hex(&state, key);
+	log_printf(LCI_SEV_DEBUG, ("cache key %s\n", key));
+	if (open_entry(cache, dir, key)) {
+		store_manifest(cache);
+		return 1;
+	}
+	if (NULL == cache->entry) {
+		lint_cache_abort(cache);
+		return 0;
+	}
+	log_printf(LCI_SEV_INFORMATIONAL, ("cache miss %s\n", key));
+	shard = shard_of(cache->entry);
+	cache->out_tmp = make_temp(shard, "tmp.out", &cache->out_fd);
+	if (cache->out_tmp != NULL)
+		cache->err_tmp = make_temp(shard, "tmp.err", &cache->err_fd);
+	free(shard);
+	if (NULL == cache->err_tmp) {
+		lint_cache_abort(cache);
+		return 0;
+	}
+	return 1;
+}
+
+int lint_cache_hit(struct lint_cache const *cache)
+{
+	return cache->hit != NULL;
+}
+
+static void store_entry(struct lint_cache *cache, int code)
+{
+	unsigned long const out_size = file_size(cache->out_tmp);
+	unsigned long const err_size = file_size(cache->err_tmp);
+	char *shard = shard_of(cache->entry);
+	char *tmp;
+	FILE *f;
+	int fd;
+	int ok;
+
+	tmp = make_temp(shard, "tmp", &fd);
+	if (NULL == tmp) {
+		free(shard);
+		return;
+	}
+	f = fdopen(fd, "wb");
+	ok = (f != NULL);
+	if (ok) {
+		ok = (fprintf(f, CACHE_MAGIC " %d %lu %lu\n", code, out_size,
+			      err_size) > 0);
+		ok = ok && copy_file(cache->out_tmp, f, out_size);
+		ok = ok && copy_file(cache->err_tmp, f, err_size);
+		ok = !ferror(f) && ok;
+		ok = (fclose(f) == 0) && ok;
+	} else {
+		(void)close(fd);
+	}
+	if (ok && cache->output != NULL) {
+		char *const path = output_path(cache);
+
+		ok = copy_output(cache->output, path);
+		free(path);
+	}
+	/*
+	 * rename is atomic, concurrent readers see all or nothing.  The
+	 * output is in place before the entry that needs it.
+	 */
+	if (ok && rename(tmp, cache->entry) == 0) {
+		log_printf(LCI_SEV_DEBUG, ("stored %s\n", cache->entry));
+		store_manifest(cache);
+		count_added(shard, out_size + err_size);
+	} else {
+		log_printf(LCI_SEV_WARNING,
+			   ("cannot store %s\n", cache->entry));
+		(void)unlink(tmp);
+	}
+	free(tmp);
+	free(shard);
+}
+
+int lint_cache_finish(struct lint_cache *cache, int status)
+{
+	int code;
+
+	if (cache->hit != NULL) {
+		code = replay_entry(cache->hit);
+		if (code < 0) {
+			log_printf(LCI_SEV_WARNING,
+				   ("corrupt %s\n", cache->entry));
+			(void)unlink(cache->entry);
+			code = EXIT_FAILURE;
+		}
+	} else {
+		if (WIFEXITED(status)) {
+			code = WEXITSTATUS(status);
+			store_entry(cache, code);
+		} else {
+			code = WIFSIGNALED(status) ?
+			    WTERMSIG(status) : EXIT_FAILURE;
+		}
+		(void)copy_file(cache->out_tmp, stdout,
+				file_size(cache->out_tmp));
+		(void)copy_file(cache->err_tmp, stderr,
+				file_size(cache->err_tmp));
+	}
+	lint_cache_abort(cache);
+	return code;
+}
+
+void lint_cache_abort(struct lint_cache *cache)
+{
+	discard_temps(cache);
+	if (cache->hit != NULL) {
+		(void)fclose(cache->hit);
+		cache->hit = NULL;
+	}
+	free(cache->entry);
+	free(cache->manifest);
+	free(cache->manifest_text);
+	cache->entry = NULL;
+	cache->manifest = NULL;
+	cache->manifest_text = NULL;
+}
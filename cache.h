@@ -0,0 +1,72 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_CACHE_H_
+#define LCI_INC_CACHE_H_
+#else
+#error "LCI_INC_CACHE_H_"
+#endif
+
+/*
+ * Lint result cache, enabled by setting LCI_CACHE_DIR.  Entries are keyed
+ * on the preprocessed translation unit, the lint argv and the identity of
+ * the lint binary, and hold lint's stdout, stderr and exit code.
+ * LCI_CACHE_SIZE bounds the cache size (suffix k, M or G), oldest used
+ * entries are evicted first.
+ *
+ * In direct mode, the default unless LCI_NODIRECT is set, a manifest of
+ * the included files is kept per source file and argv, so a translation
+ * unit whose files are unchanged is looked up without preprocessing.
+ * When lci compiles before it lints, the dependency file of the compile
+ * names those files and the preprocessor is not run on a miss either.
+ *
+ * A file lint writes besides its output, like a lint object, is kept next
+ * to the entry and restored on a hit.
+ */
+
+/*
+ * The dependency file of a compile that lci runs
+ */
+struct compile_deps {
+	char *path;		/*!< dependency file, NULL for none */
+	int temporary;		/*!< added by lci, removed after use */
+	time_t start;		/*!< when the compile started */
+};
+
+struct lint_cache {
+	char *entry;		/*!< path of the cache entry */
+	FILE *hit;		/*!< open entry on cache hit, else NULL */
+	char *manifest;		/*!< direct mode manifest path */
+	char *manifest_text;	/*!< manifest to store on a miss */
+	char const *output;	/*!< file lint writes, or NULL */
+	char *out_tmp;		/*!< lint stdout capture on cache miss */
+	char *err_tmp;		/*!< lint stderr capture on cache miss */
+	int out_fd;
+	int err_fd;
+};
+
+extern char **lint_cache_depend(struct compile_deps *deps, char *argv[],
+				char *compiler_argv[]);
+extern void lint_cache_depend_end(struct compile_deps *deps);
+extern int lint_cache_begin(struct lint_cache *cache, char *compiler_argv[],
+			    char *lint_argv[], struct compile_deps const *deps,
+			    char const *output);
+extern int lint_cache_hit(struct lint_cache const *cache);
+extern int lint_cache_finish(struct lint_cache *cache, int status);
+extern void lint_cache_abort(struct lint_cache *cache);
+extern unsigned long parse_size(char const *str);
@@ -16,8 +16,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <libgen.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,7 +29,20 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "analyzer.h"
+#include "args.h"
+#include "async.h"
+#include "cache.h"
 #include "core.h"
+#include "dedup.h"
+#include "jobserver.h"
+#include "output.h"
+#include "priority.h"
+#include "process.h"
+#include "queue.h"
+#include "response.h"
+#include "server.h"
+#include "trace.h"
 #include "util.h"
 
 #define CANONICAL_TOOL_NAME "Lint Compiler Interceptor"
@@ -34,6 +50,22 @@
 
 static char lint[] = "fake-lint-nt.exe";
 
+/*
+ * The lint object lint writes for the module it lints, or NULL
+ */
+static char *lint_object = NULL;
+
+/*
+ * The compiler argv, set when lint may run on a remote worker
+ */
+static char **remote_compile_argv = NULL;
+
+/*
+ * The analyzers of LCI_ANALYZERS, run instead of lint
+ */
+static struct analyzer analyzers[MAX_ANALYZERS];
+static int analyzer_count = 0;
+
 static char const *copyright[] = {
 	COPYRIGHT_STRING,
 	"License GPLv2: GNU GPL version 2 or later <http://gnu.org/licenses/>",
@@ -59,21 +91,57 @@ static char const *usage[] = {
 	"    compiler [compiler options]    (via symbolic link)",
 	"",
 	"options:",
+	"    -a, --async        lint in the background after compile",
 	"    -b, --no-banner    suppress banner",
 	"    -c, --no-compiler  do not run compiler",
 	"    -f, --force-lint   run lint even after failed compile",
 	"    -l, --no-lint      do not run lint",
+	"    -p, --parallel     run compiler and lint concurrently",
+	"    -q, --queue-lint   queue lint for a later --flush-lint",
 	"    -v, --verbose      verbose output",
 	"",
+	"        --dedup-stats  print LCI_DEDUP diagnostic counts and exit",
+	"        --flush-lint   lint all queued translation units and exit",
 	"        --help         print this text and exit",
+	"        --server       serve lint runs on the LCI_SERVER socket",
+	"        --trace-json   print LCI_TRACE as Chrome trace JSON and exit",
 	"        --version      print version and exit",
+	"        --wait         wait for --async lint, print results and exit",
+	"",
+	"environment:",
+	"    LCI_ANALYZERS      program:style:jobs analyzers to run, not lint",
+	"    LCI_ANALYZER_POLICY exit code of analyzers: worst, first or all",
+	"    LCI_CACHE_DIR      lint result cache directory, unset disables",
+	"    LCI_CACHE_SIZE     lint result cache size limit, default 1G",
+	"    LCI_CGROUP         cgroup v2 directory to run lint in",
+	"    LCI_COMPILERS      compilers liblci-preload.so intercepts",
+	"    LCI_DEDUP          file of a table to print each diagnostic once",
+	"    LCI_GLOBAL_LINT    keep lint objects and lint them on link",
+	"    LCI_GROUP_OUTPUT   print output per unit in a block, prefix, tag",
+	"    LCI_LOG            file to append binary log records to, lci-log",
+	"    LCI_LOG_LEVEL      log severity ceiling 0-7, default 5 (notice)",
+	"    LCI_MAX_LOAD       delay lint while the load average is above",
+	"    LCI_MAX_PRESSURE   delay lint while CPU pressure (%) is above",
+	"    LCI_NICE           lower lint CPU priority by this, idle I/O",
+	"    LCI_NODIRECT       always preprocess to find cached lint results",
+	"    LCI_PROGRAM        lci started by liblci-preload.so, default lci",
+	"    LCI_QUEUE          lint queue file of --queue-lint and --flush-lint",
+	"    LCI_RESULTS        lint results directory of --async and --wait",
+	"    LCI_SERVER         socket of a lint server to run lint on",
+	"    LCI_SERVER_JOBS    lint processes of --server, default CPU count",
+	"    LCI_TRACE          file to append resource usage of each run to",
+	"    LCI_WORKERS        lci-worker host:port list to run lint on",
+	"    MAKEFLAGS          a make jobserver limits --parallel lint runs",
 	"",
 	"Report bugs to: mailing-address",
 	CANONICAL_TOOL_NAME " home page: <https://github.com/bolry/lci/>",
 	NULL
 };
 
+int async_lint = 0;
 int force_lint = 0;
+int parallel_lint = 0;
+int queue_lint = 0;
 int run_compiler = 1;
 int run_lint = 1;
 int show_banner = 1;
@@ -128,7 +196,8 @@ int parse_bool_flag(char const unknown_arg[], char const option[],
 		match = (strcmp(unknown_arg, option) == 0);
 	} else {
 		char const *const res = strstr(option, unknown_arg);
-		log_printf(LCI_SEV_DEBUG, "first %d must match\n", unique_from);
+		log_printf(LCI_SEV_DEBUG,
+			   ("first %d must match\n", unique_from));
 		if (res != option)
 			match = 0;
 		else
@@ -150,6 +219,158 @@ void remove_index(int *offset, int *cnt, char *vec[])
 	--(*offset);
 }
 
+/*
+ * lint waits for a quiet system and runs on idle cycles, once however it
+ * is started
+ */
+static void yield_to_compiles(void)
+{
+	static int yielded = 0;
+
+	if (yielded)
+		return;
+	yielded = 1;
+	lint_wait_for_idle();
+	lint_lower_priority();
+}
+
+static void flush_lint_queue(void)
+{
+	char const *const queue = lint_queue_path();
+
+	if (NULL == queue) {
+		fputs(TOOL_NAME ": LCI_QUEUE is not set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	if (dedup_path() != NULL)
+		dedup_begin(dedup_path());
+	yield_to_compiles();
+	exit(lint_queue_flush(queue, lint));
+}
+
+static void serve_lint(void)
+{
+	char const *const path = lint_server_path();
+	char const *const jobs = getenv("LCI_SERVER_JOBS");
+
+	if (NULL == path) {
+		fputs(TOOL_NAME ": LCI_SERVER is not set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	exit(lint_server_main(path, (jobs != NULL) ? atoi(jobs) :
+			      (int)sysconf(_SC_NPROCESSORS_ONLN)));
+}
+
+static void wait_for_lint(void)
+{
+	char const *const dir = async_results_path();
+
+	if (NULL == dir) {
+		fputs(TOOL_NAME ": LCI_RESULTS is not set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	exit(async_wait(dir));
+}
+
+static void print_trace_json(void)
+{
+	char const *const path = trace_path();
+
+	if (NULL == path) {
+		fputs(TOOL_NAME ": LCI_TRACE is not set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	exit(trace_to_json(path, stdout));
+}
+
+static void print_dedup_stats(void)
+{
+	char const *const path = dedup_path();
+
+	if (NULL == path) {
+		fputs(TOOL_NAME ": LCI_DEDUP is not set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	exit(dedup_stats(path, stdout));
+}
+
+static void print_help(void)
+{
+	print_usage_on(stdout);
+	exit(EXIT_SUCCESS);
+}
+
+static void print_version(void)
+{
+	print_version_on(stdout);
+	exit(EXIT_SUCCESS);
+}
+
+/*
+ * An option either sets *flag to value or calls action
+ */
+struct lci_option {
+	char short_name;
+	char const *long_name;
+	int unique_from;
+	int *flag;
+	int value;
+	void (*action) (void);
+	char const *debug;
+};
+
+/*
+ * Abbreviations resolve to the first option they match, so order matters
+ * for long names sharing a prefix
+ */
+static struct lci_option const options[] = {
+	{ 'a', "--async", 3, &async_lint, 1, NULL, "async\n" },
+	{ 'b', "--no-banner", 6, &show_banner, 0, NULL, "no banner\n" },
+	{ 'c', "--no-compiler", 6, &run_compiler, 0, NULL, "no compiler\n" },
+	{ 'f', "--force-lint", 3, &force_lint, 1, NULL, "force lint\n" },
+	{ 'l', "--no-lint", 6, &run_lint, 0, NULL, "no lint\n" },
+	{ 'p', "--parallel", 3, &parallel_lint, 1, NULL, "parallel\n" },
+	{ 'q', "--queue-lint", 3, &queue_lint, 1, NULL, "queue lint\n" },
+	{ 'v', "--verbose", 6, NULL, 0, inc_severity_ceiling, "verbose\n" },
+	{ '\0', "--dedup-stats", 3, NULL, 0, print_dedup_stats,
+	  "dedup stats\n" },
+	{ '\0', "--flush-lint", 4, NULL, 0, flush_lint_queue, "flush lint\n" },
+	{ '\0', "--help", 3, NULL, 0, print_help, "help\n" },
+	{ '\0', "--server", 3, NULL, 0, serve_lint, "server\n" },
+	{ '\0', "--trace-json", 3, NULL, 0, print_trace_json, "trace json\n" },
+	{ '\0', "--version", 6, NULL, 0, print_version, "version\n" },
+	{ '\0', "--wait", 3, NULL, 0, wait_for_lint, "wait\n" }
+};
+
+static struct lci_option const *find_option(char const *arg)
+{
+	size_t const count = sizeof(options) / sizeof(*options);
+	size_t len;
+	size_t i;
+
+	if (arg[0] != '-' || '\0' == arg[1])
+		return NULL;
+	if ('\0' == arg[2]) {
+		for (i = 0; i != count; ++i)
+			if (options[i].short_name == arg[1])
+				return &options[i];
+		return NULL;
+	}
+	if (arg[1] != '-')
+		return NULL;
+	len = strlen(arg);
+	for (i = 0; i != count; ++i)
+		if (options[i].long_name[2] == arg[2] &&
+		    len >= (size_t)options[i].unique_from &&
+		    strncmp(options[i].long_name, arg, len) == 0)
+			return &options[i];
+	return NULL;
+}
+
+/*
+ * lci options come first, they are removed from vec in one move once the
+ * compiler is found
+ */
 void lci_options(int *cnt, char *vec[])
 {
 	int i;
@@ -159,58 +380,40 @@ void lci_options(int *cnt, char *vec[])
 		exit(EXIT_FAILURE);
 	}
 	for (i = 1; i != *cnt; ++i) {
-		if (parse_bool_flag(vec[i], "-b", -1) ||
-		    parse_bool_flag(vec[i], "--no-banner", 6)) {
-			log_puts(LCI_SEV_DEBUG, "no banner\n");
-			show_banner = 0;
-			remove_index(&i, cnt, &vec[0]);
-			continue;
-		}
-		if (parse_bool_flag(vec[i], "-c", -1) ||
-		    parse_bool_flag(vec[i], "--no-compiler", 6)) {
-			log_puts(LCI_SEV_DEBUG, "no compiler\n");
-			run_compiler = 0;
-			remove_index(&i, cnt, &vec[0]);
-			continue;
-		}
-		if (parse_bool_flag(vec[i], "-f", -1) ||
-		    parse_bool_flag(vec[i], "--force-lint", 3)) {
-			log_puts(LCI_SEV_DEBUG, "force lint\n");
-			force_lint = 1;
-			remove_index(&i, cnt, &vec[0]);
-			continue;
-		}
-		if (parse_bool_flag(vec[i], "-l", -1) ||
-		    parse_bool_flag(vec[i], "--no-lint", 6)) {
-			log_puts(LCI_SEV_DEBUG, "no lint\n");
-			run_lint = 0;
-			remove_index(&i, cnt, &vec[0]);
-			continue;
-		}
-		if (parse_bool_flag(vec[i], "-v", -1) ||
-		    parse_bool_flag(vec[i], "--verbose", 6)) {
-			log_puts(LCI_SEV_DEBUG, "verbose\n");
-			inc_severity_ceiling();
-			remove_index(&i, cnt, &vec[0]);
-			continue;
-		}
-		if (parse_bool_flag(vec[i], "--help", 3)) {
-			log_puts(LCI_SEV_DEBUG, "help\n");
-			print_usage_on(stdout);
-			exit(EXIT_SUCCESS);
-		}
-		if (parse_bool_flag(vec[i], "--version", 6)) {
-			log_puts(LCI_SEV_DEBUG, "version\n");
-			print_version_on(stdout);
-			exit(EXIT_SUCCESS);
-		}
-		break;
+		struct lci_option const *const opt = find_option(vec[i]);
+
+		if (NULL == opt)
+			break;
+		log_puts(LCI_SEV_DEBUG, opt->debug);
+		if (opt->flag != NULL)
+			*opt->flag = opt->value;
+		else
+			opt->action();
+	}
+	if (i != 1) {
+		memmove(&vec[1], &vec[i],
+			sizeof(char *) * (size_t)(*cnt - i + 1));
+		*cnt -= i - 1;
 	}
 }
 
+/*
+ * Lint is only worth running when source files are compiled, not for
+ * preprocessing, dependency scans, version probes, configure tests or
+ * link steps
+ */
 int will_compile_and_or_link(int argc, char *argv[])
 {
-	return 1;
+	struct compile_args info;
+
+	if (argc < 2)
+		return 0;
+	classify_compile(&info, argc - 1, &argv[1]);
+	log_printf(LCI_SEV_DEBUG, ("%d sources %d objects%s%s\n",
+		   info.sources, info.objects,
+		   info.no_compile ? " no compile" : "",
+		   info.probe ? " probe" : ""));
+	return info.sources != 0 && !info.no_compile && !info.probe;
 }
 
 static void print_banner(void)
@@ -240,57 +443,411 @@ static void only_run_lint_if_compile_and_or_link(int argc, char *argv[])
 			run_lint = 0;
 }
 
+static int exit_code_of(int status)
+{
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status);
+	if (WIFSIGNALED(status))
+		return WTERMSIG(status);
+	return EXIT_FAILURE;
+}
+
+static int child_failed(int status)
+{
+	return !WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS);
+}
+
+static void exit_like_child(int status)
+{
+	exit(exit_code_of(status));
+}
+
+static int begin_lint(char *args[], char *lint_argv[],
+		      struct compile_deps const *deps, struct lint_cache *cache)
+{
+	return lint_cache_begin(cache, &args[1], &lint_argv[0], deps,
+				lint_object);
+}
+
+struct server_request {
+	int sock;
+	char **argv;
+};
+
+static int run_on_server(void *data)
+{
+	struct server_request const *req = (struct server_request *)data;
+	return lint_server_run(req->sock, req->argv);
+}
+
+/*
+ * Lints on the least loaded worker, locally when there is none or the
+ * unit could not be shipped
+ */
+static int run_on_worker(void *data)
+{
+	char **const argv = (char **)data;
+	int const sock = lint_worker_connect(lint_workers());
+	int code = -1;
+
+	if (sock != -1) {
+		code = lint_worker_run(sock, remote_compile_argv, &argv[0]);
+		(void)close(sock);
+	}
+	if (code >= 0)
+		return code;
+	(void)fflush(NULL);
+	log_flush();
+	(void)execvp(argv[0], &argv[0]);
+	perror(TOOL_NAME ": execvp");
+	return EXIT_FAILURE;
+}
+
+/*
+ * Nothing is started on a cache hit.  With a lint server or remote
+ * workers the child only relays the run and is traced as lint.
+ */
+static pid_t start_lint(char *argv[], struct lint_cache const *cache,
+			int cached)
+{
+	struct server_request req;
+	int const out_fd = cached ? cache->out_fd : -1;
+	int const err_fd = cached ? cache->err_fd : -1;
+	pid_t lpid;
+
+	if (cached && lint_cache_hit(cache))
+		return -1;
+	yield_to_compiles();
+	req.sock = lint_server_connect(lint_server_path());
+	if (-1 == req.sock && remote_compile_argv != NULL) {
+		lpid = start_function(run_on_worker, &argv[0], out_fd, err_fd);
+		trace_started(lpid, argv[0]);
+		return lpid;
+	}
+	if (-1 == req.sock)
+		return start_child(&argv[0], out_fd, err_fd);
+	req.argv = &argv[0];
+	lpid = start_function(run_on_server, &req, out_fd, err_fd);
+	trace_started(lpid, argv[0]);
+	(void)close(req.sock);
+	return lpid;
+}
+
+static int finish_lint(pid_t lpid, struct lint_cache *cache, int cached)
+{
+	int status = 0;
+
+	if (lpid != -1)
+		status = wait_child(lpid);
+	if (cached)
+		return lint_cache_finish(cache, status);
+	return exit_code_of(status);
+}
+
+static void exit_lint(int code)
+{
+	async_finish(code);
+	exit(code);
+}
+
+/*
+ * lci exits with the exit code of the compiler and lint goes on in the
+ * background, in the foreground when that fails
+ */
+static void detach_lint(int code)
+{
+	int const detached = async_detach(async_results_path());
+
+	if (0 == detached)
+		exit(code);
+	if (detached > 0 && dedup_path() != NULL)
+		dedup_begin(dedup_path());
+}
+
+/*
+ * deps is the dependency file of the compile just run, or NULL
+ */
+static void exec_lint(char *args[], char *lint_argv[],
+		      struct compile_deps *deps)
+{
+	struct lint_cache cache;
+	int cached;
+	int sock;
+
+	cached = begin_lint(&args[0], &lint_argv[0], deps, &cache);
+	if (deps != NULL)
+		lint_cache_depend_end(deps);
+	if (cached)
+		exit_lint(finish_lint(start_lint(&lint_argv[0], &cache, 1),
+				      &cache, 1));
+	/*
+	 * lint is waited for to account for it, to let the diagnostic filter
+	 * and the output block finish and to record its exit code in the
+	 * background
+	 */
+	if (trace_path() != NULL || dedup_path() != NULL ||
+	    remote_compile_argv != NULL || async_lint || output_mode() != NULL)
+		exit_lint(finish_lint(start_lint(&lint_argv[0], &cache, 0),
+				      &cache, 0));
+	yield_to_compiles();
+	sock = lint_server_connect(lint_server_path());
+	if (sock != -1)
+		exit_lint(lint_server_run(sock, &lint_argv[0]));
+	log_flush();
+	(void)execvp(lint_argv[0], &lint_argv[0]);
+	perror(TOOL_NAME ": execvp");
+}
+
+/*
+ * Lint needs a jobserver token to run besides the compiler, without one
+ * it runs after the compiler in the job slot of lci
+ */
+static void run_compiler_and_queue_lint(char *argv[], char *args[],
+					char *lint_argv[])
+{
+	struct compile_deps deps;
+	int code = EXIT_SUCCESS;
+
+	if (run_compiler) {
+		char **const cargv = lint_cache_depend(&deps, &argv[1],
+						       &args[1]);
+		int const status = wait_child(start_child(cargv, -1, -1));
+		if (child_failed(status) && (!force_lint || WIFSIGNALED(status))) {
+			lint_cache_depend_end(&deps);
+			exit_like_child(status);
+		}
+		code = exit_code_of(status);
+	}
+	if (lint_queue_append(lint_queue_path(), &lint_argv[0])) {
+		if (run_compiler)
+			lint_cache_depend_end(&deps);
+		exit(code);
+	}
+	exec_lint(&args[0], &lint_argv[0], run_compiler ? &deps : NULL);
+}
+
+/*
+ * The analyzers run side by side after the compile as far as the make
+ * jobserver lets them, locally and without the cache
+ */
+static void run_compiler_and_analyzers(char *argv[], char *args[], int nargs)
+{
+	int code = EXIT_SUCCESS;
+
+	if (run_compiler) {
+		int const status = wait_child(start_child(&argv[1], -1, -1));
+		if (child_failed(status) && (!force_lint || WIFSIGNALED(status)))
+			exit_like_child(status);
+		code = exit_code_of(status);
+	}
+	if (async_lint)
+		detach_lint(code);
+	yield_to_compiles();
+	code = run_analyzers(analyzers, analyzer_count, nargs - 1, &args[1]);
+	exit_lint(code);
+}
+
+/*
+ * The global lint pass over the lint objects of what is linked, it reads
+ * files the cache does not know of and is never cached
+ */
+static void run_linker_and_global_lint(char *argv[], char *global_argv[])
+{
+	int const status = wait_child(start_child(&argv[1], -1, -1));
+
+	if (child_failed(status))
+		exit_like_child(status);
+	exit(finish_lint(start_lint(&global_argv[0], NULL, 0), NULL, 0));
+}
+
+static int global_lint(void)
+{
+	char const *value = getenv("LCI_GLOBAL_LINT");
+	return value != NULL && *value != '\0';
+}
+
+/*
+ * With LCI_GLOBAL_LINT, the argv of lint over the lint objects of a link
+ * of objects only, else NULL
+ */
+static char **global_lint_args(int argc, char *argv[])
+{
+	struct compile_args info;
+
+	if (!run_compiler || !run_lint || !global_lint() || argc < 2)
+		return NULL;
+	classify_compile(&info, argc - 1, &argv[1]);
+	if (info.sources != 0 || 0 == info.objects || info.no_compile ||
+	    info.compile_only || info.probe)
+		return NULL;
+	return lint_object_args(lint_args(lint, argc - 1, &argv[1]),
+				argc - 1, &argv[1]);
+}
+
+static void run_compiler_and_lint_in_parallel(char *argv[], char *args[],
+					      char *lint_argv[])
+{
+	struct jobserver jobserver;
+	struct lint_cache cache;
+	int cached;
+	int deferred = 0;
+	int cstatus;
+	int lcode;
+	pid_t cpid;
+	pid_t lpid = -1;
+
+	jobserver_open(&jobserver);
+	cpid = start_child(&argv[1], -1, -1);
+	cached = begin_lint(&args[0], &lint_argv[0], NULL, &cache);
+	if (!cached || !lint_cache_hit(&cache)) {
+		/*
+		 * a busy system gets the compile done first
+		 */
+		if (!lint_system_busy() && jobserver_try_acquire(&jobserver))
+			lpid = start_lint(&lint_argv[0], &cache, cached);
+		else
+			deferred = 1;
+	}
+	cstatus = wait_child(cpid);
+	if (child_failed(cstatus) && !force_lint) {
+		/*
+		 * lint result is of no use, do not wait for it to finish
+		 */
+		log_puts(LCI_SEV_INFORMATIONAL, "compile failed, stop lint\n");
+		if (lpid != -1) {
+			(void)kill(lpid, SIGTERM);
+			(void)wait_child(lpid);
+		}
+		jobserver_close(&jobserver);
+		if (cached)
+			lint_cache_abort(&cache);
+		exit_like_child(cstatus);
+	}
+	if (deferred) {
+		log_puts(LCI_SEV_INFORMATIONAL, "lint after compile\n");
+		lpid = start_lint(&lint_argv[0], &cache, cached);
+	}
+	lcode = finish_lint(lpid, &cache, cached);
+	jobserver_close(&jobserver);
+	/*
+	 * a failed compile takes precedence over lint findings
+	 */
+	if (child_failed(cstatus))
+		exit_like_child(cstatus);
+	exit(lcode);
+}
+
 int lci_main(int argc, char *argv[])
 {
+	char **lint_argv = NULL;
+	char **global_argv;
+	char **args;
+	int nargs;
+
+	log_begin();
 	handle_possible_lci_options(&argc, &argv[0]);
+	/*
+	 * the compiler gets its response files, classification, lint and the
+	 * cache see what is in them
+	 */
+	nargs = argc;
+	args = expand_response_files(&nargs, &argv[0]);
+	trace_begin(lint, nargs - 1, &args[1]);
+	analyzer_count = analyzers_configured(analyzers);
 	print_banner();
-	only_run_lint_if_compile_and_or_link(argc, &argv[0]);
+	global_argv = global_lint_args(nargs, &args[0]);
+	only_run_lint_if_compile_and_or_link(nargs, &args[0]);
 	flush_all();
-	if (run_compiler && run_lint) {
+	if (queue_lint && NULL == lint_queue_path()) {
+		log_puts(LCI_SEV_WARNING, "LCI_QUEUE not set, lint now\n");
+		queue_lint = 0;
+	}
+	if (async_lint && NULL == async_results_path()) {
+		log_puts(LCI_SEV_WARNING, "LCI_RESULTS not set, lint now\n");
+		async_lint = 0;
+	}
+	/*
+	 * analyzers are not queued, they run like lint does without -q
+	 */
+	if (analyzer_count != 0)
+		queue_lint = 0;
+	/*
+	 * queued and global lint are not waited for by the compile anyway,
+	 * background lint starts after the compile, not beside it
+	 */
+	if (queue_lint || global_argv != NULL)
+		async_lint = 0;
+	if (async_lint)
+		parallel_lint = 0;
+	if (run_lint && 0 == analyzer_count) {
+		lint_argv = lint_args(lint, nargs - 1, &args[1]);
+		/*
+		 * queued modules are linted in groups, without lint objects
+		 */
+		if (global_lint() && !queue_lint)
+			lint_object = lint_object_file(nargs - 1, &args[1]);
+		if (lint_object != NULL)
+			lint_argv = lint_object_output(lint_argv, lint_object);
+		/*
+		 * a lint object stays local, so does a unit that is queued
+		 */
+		else if (lint_workers() != NULL && !queue_lint)
+			remote_compile_argv = &args[1];
+		lint_argv = lint_response_args(lint_argv);
+	}
+	/*
+	 * the diagnostic filter writes into the block of the unit
+	 */
+	if ((run_lint || global_argv != NULL) && output_mode() != NULL &&
+	    !async_lint)
+		output_begin(output_mode(), output_unit(nargs - 1, &args[1]));
+	if ((run_lint || global_argv != NULL) && dedup_path() != NULL &&
+	    !async_lint)
+		dedup_begin(dedup_path());
+	if (global_argv != NULL) {
+		run_linker_and_global_lint(&argv[0], global_argv);
+	} else if (run_lint && analyzer_count != 0) {
+		run_compiler_and_analyzers(&argv[0], &args[0], nargs);
+	} else if (run_lint && queue_lint) {
+		run_compiler_and_queue_lint(&argv[0], &args[0], &lint_argv[0]);
+	} else if (run_compiler && run_lint && parallel_lint) {
+		run_compiler_and_lint_in_parallel(&argv[0], &args[0],
+						  &lint_argv[0]);
+	} else if (run_compiler && run_lint) {
 		/*
 		 * run compiler first and if OK then run lint
 		 */
+		struct compile_deps deps;
+		char **cargv;
 		int status;
-		pid_t cpid;
-		pid_t w;
 
-		cpid = fork();
-		if (-1 == cpid) {
-			perror(TOOL_NAME ": fork");
-			exit(EXIT_FAILURE);
-		}
-		if (0 == cpid) {
-			(void)execvp(argv[1], &argv[1]);
-			perror(TOOL_NAME ": execvp");
-			_exit(EXIT_FAILURE);
-		}
-		errno = 0;
-		w = waitpid(cpid, &status, 0);
-		if (w != cpid) {
-			perror(TOOL_NAME ": waitpid");
-			exit(EXIT_FAILURE);
-		}
+		cargv = lint_cache_depend(&deps, &argv[1], &args[1]);
+		status = wait_child(start_child(cargv, -1, -1));
 		if (WIFEXITED(status) && (WEXITSTATUS(status) != EXIT_SUCCESS)) {
 			if (force_lint) {
 				/*
 				 * run lint anyway
 				 */
 			} else {
+				lint_cache_depend_end(&deps);
 				exit(WEXITSTATUS(status));
 			}
 		}
-		if (WIFSIGNALED(status))
+		if (WIFSIGNALED(status)) {
+			lint_cache_depend_end(&deps);
 			exit(WTERMSIG(status));
-		argv[0] = lint;
-		(void)execvp(argv[0], &argv[0]);
-		perror(TOOL_NAME ": execvp");
+		}
+		if (async_lint)
+			detach_lint(exit_code_of(status));
+		exec_lint(&args[0], &lint_argv[0], &deps);
 	} else if (run_compiler) {
+		log_flush();
 		(void)execvp(argv[1], &argv[1]);
 		perror(TOOL_NAME ": execvp");
 	} else if (run_lint) {
-		argv[0] = lint;
-		(void)execvp(argv[0], &argv[0]);
-		perror(TOOL_NAME ": execvp");
+		if (async_lint)
+			detach_lint(EXIT_SUCCESS);
+		exec_lint(&args[0], &lint_argv[0], NULL);
 	} else {
 		/*
 		 * a do nothing option
@@ -22,7 +22,10 @@
 #error "LCI_INC_CORE_H_"
 #endif
 
+extern int async_lint;
 extern int force_lint;
+extern int parallel_lint;
+extern int queue_lint;
 extern int run_compiler;
 extern int run_lint;
 extern int show_banner;
@@ -32,3 +35,4 @@ int lci_called_by_real_name(char const *path);
 int parse_bool_flag(char const unknown_arg[], char const option[],
 		    int unique_from);
 void remove_index(int *offset, int *cnt, char *vec[]);
+int will_compile_and_or_link(int argc, char *argv[]);
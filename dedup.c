@@ -0,0 +1,350 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "dedup.h"
+#include "hash.h"
+#include "process.h"
+#include "util.h"
+
+#define DEDUP_SLOTS (1UL << 18)
+/*
+ * A fingerprint not found within this many slots is treated as new
+ */
+#define DEDUP_PROBES 64
+/*
+ * Lines held back for the next diagnostic, more are printed right away
+ */
+#define MAX_PENDING (64 * 1024)
+
+/*
+ * The mapped file, all zero is an empty table.  Slots are claimed with
+ * compare and swap, so concurrent lci processes need no lock.
+ */
+struct dedup_table {
+	unsigned long printed;
+	unsigned long suppressed;
+	unsigned long slot[DEDUP_SLOTS];
+};
+
+static pid_t filter_pid = -1;
+
+char const *dedup_path(void)
+{
+	char const *path = getenv("LCI_DEDUP");
+	return (path != NULL && *path != '\0') ? path : NULL;
+}
+
+static struct dedup_table *map_table(char const *path, int create)
+{
+	struct dedup_table *table;
+	struct stat st;
+	int fd;
+
+	fd = open(path, create ? O_RDWR | O_CREAT : O_RDONLY, 0666);
+	if (-1 == fd)
+		return NULL;
+	/*
+	 * growing to the same size twice does no harm
+	 */
+	if (fstat(fd, &st) != 0 ||
+	    ((size_t)st.st_size < sizeof(*table) &&
+	     (!create || ftruncate(fd, (off_t) sizeof(*table)) != 0))) {
+		(void)close(fd);
+		return NULL;
+	}
+	table = (struct dedup_table *)mmap(NULL, sizeof(*table),
+					   create ? PROT_READ | PROT_WRITE :
+					   PROT_READ, MAP_SHARED, fd, 0);
+	(void)close(fd);
+	return (MAP_FAILED == table) ? NULL : table;
+}
+
+static int is_kind(char const *word, size_t len)
+{
+	static char const *const kinds[] = {
+		"error", "warning", "info", "note", NULL
+	};
+	int i;
+	size_t j;
+
+	for (i = 0; kinds[i] != NULL; ++i) {
+		if (strlen(kinds[i]) != len)
+			continue;
+		for (j = 0; j != len; ++j)
+			if (tolower((unsigned char)word[j]) != kinds[i][j])
+				break;
+		if (j == len)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Finds the message kind and number, "Warning 534:", and returns where
+ * it starts, NULL when the line is not a diagnostic
+ */
+static char const *find_message(char const *line, char const **id,
+				size_t *id_len)
+{
+	char const *p;
+
+	for (p = line; *p != '\0'; ++p) {
+		char const *q = p;
+
+		if (!isalpha((unsigned char)*p) ||
+		    (p != line && isalpha((unsigned char)p[-1])))
+			continue;
+		while (isalpha((unsigned char)*q))
+			++q;
+		if (' ' != *q || !is_kind(p, (size_t)(q - p)) ||
+		    !isdigit((unsigned char)q[1]))
+			continue;
+		*id = ++q;
+		while (isdigit((unsigned char)*q))
+			++q;
+		if (':' == *q) {
+			*id_len = (size_t)(q - *id);
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * The fingerprint of a diagnostic is its file, line and message number,
+ * "f.h(12): Warning 534:", "f.h:12: Warning 534:" or "f.h  12  Warning
+ * 534:" as lint formats it.  Without a location it is the whole line.
+ * Returns 0 for lines that are not diagnostics.
+ */
+int dedup_fingerprint(char const *line, unsigned long *fingerprint)
+{
+	struct hash_state state;
+	unsigned char digest[HASH_DIGEST_SIZE];
+	char const *id;
+	size_t id_len;
+	char const *msg = find_message(line, &id, &id_len);
+	char const *p;
+	size_t i;
+
+	if (NULL == msg)
+		return 0;
+	hash_init(&state);
+	for (p = line; p != msg; ++p) {
+		char const *q = p + 1;
+
+		if (p == line || !(' ' == *p || '\t' == *p || '(' == *p ||
+				   ':' == *p) || !isdigit((unsigned char)*q))
+			continue;
+		while (isdigit((unsigned char)*q))
+			++q;
+		if (' ' == *q || '\t' == *q || ')' == *q || ':' == *q ||
+		    ',' == *q)
+			break;
+	}
+	if (p == msg) {
+		hash_string(&state, line);
+	} else {
+		char const *end = p;
+
+		while (end != line && (' ' == end[-1] || '\t' == end[-1]))
+			--end;
+		hash_update(&state, line, (size_t)(end - line));
+		hash_update(&state, "", 1u);
+		for (++p; isdigit((unsigned char)*p); ++p)
+			hash_update(&state, p, 1u);
+		hash_update(&state, "", 1u);
+		hash_update(&state, id, id_len);
+	}
+	hash_final(&state, digest);
+	*fingerprint = 0;
+	for (i = 0; i != sizeof(*fingerprint) && i != HASH_DIGEST_SIZE; ++i)
+		*fingerprint = (*fingerprint << 8) | digest[i];
+	if (0 == *fingerprint)
+		*fingerprint = 1;
+	return 1;
+}
+
+/*
+ * Returns 1 when this is the first time the fingerprint is seen
+ */
+static int first_seen(struct dedup_table *table, unsigned long fingerprint)
+{
+	unsigned long volatile *slot = table->slot;
+	unsigned long i = fingerprint & (DEDUP_SLOTS - 1UL);
+	int probe;
+
+	for (probe = 0; probe != DEDUP_PROBES; ++probe) {
+		if (slot[i] == fingerprint)
+			return 0;
+		if (0 == slot[i]) {
+			if (__sync_bool_compare_and_swap(&slot[i], 0UL,
+							 fingerprint))
+				return 1;
+			if (slot[i] == fingerprint)
+				return 0;
+		}
+		i = (i + 1UL) & (DEDUP_SLOTS - 1UL);
+	}
+	return 1;
+}
+
+/*
+ * Held back lines are printed with a new diagnostic, only module headers
+ * of lint are printed with a repeated one
+ */
+static void flush_pending(char *pending, size_t len, int keep_all, FILE * out)
+{
+	char *line = pending;
+	char *const end = pending + len;
+
+	while (line != end) {
+		char *nl = (char *)memchr(line, '\n', (size_t)(end - line));
+		char *const next = (NULL == nl) ? end : nl + 1;
+
+		if (keep_all || strncmp(line, "---", 3u) == 0)
+			(void)fwrite(line, 1u, (size_t)(next - line), out);
+		line = next;
+	}
+}
+
+static int run_filter(void *data)
+{
+	struct dedup_table *const table = map_table((char const *)data, 1);
+	char *pending = (char *)xmalloc(MAX_PENDING);
+	size_t pending_len = 0;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	while ((len = getline(&line, &size, stdin)) > 0) {
+		unsigned long fingerprint;
+
+		if (NULL == table || !dedup_fingerprint(line, &fingerprint)) {
+			if (pending_len + (size_t)len > MAX_PENDING) {
+				flush_pending(pending, pending_len, 1, stdout);
+				pending_len = 0;
+			}
+			if ((size_t)len > MAX_PENDING) {
+				(void)fwrite(line, 1u, (size_t)len, stdout);
+			} else {
+				memcpy(&pending[pending_len], line,
+				       (size_t)len);
+				pending_len += (size_t)len;
+			}
+			continue;
+		}
+		if (first_seen(table, fingerprint)) {
+			(void)__sync_fetch_and_add(&table->printed, 1UL);
+			flush_pending(pending, pending_len, 1, stdout);
+			(void)fwrite(line, 1u, (size_t)len, stdout);
+		} else {
+			(void)__sync_fetch_and_add(&table->suppressed, 1UL);
+			flush_pending(pending, pending_len, 0, stdout);
+		}
+		pending_len = 0;
+	}
+	flush_pending(pending, pending_len, 1, stdout);
+	free(line);
+	free(pending);
+	return (fflush(stdout) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+struct filter_start {
+	int read_fd;
+	int write_fd;
+	char const *path;
+};
+
+static int start_filter(void *data)
+{
+	struct filter_start *const start = (struct filter_start *)data;
+
+	(void)close(start->write_fd);
+	if (dup2(start->read_fd, STDIN_FILENO) == -1) {
+		perror(TOOL_NAME ": dup2");
+		return EXIT_FAILURE;
+	}
+	(void)close(start->read_fd);
+	return run_filter((void *)start->path);
+}
+
+/*
+ * From here on stdout of lci and its children goes through the filter,
+ * dedup_end waits for it to print everything
+ */
+void dedup_begin(char const *path)
+{
+	struct filter_start start;
+	int fds[2];
+
+	if (fflush(stdout) == EOF || pipe(fds) == -1) {
+		perror(TOOL_NAME ": dedup");
+		return;
+	}
+	start.read_fd = fds[0];
+	start.write_fd = fds[1];
+	start.path = path;
+	filter_pid = start_function(start_filter, &start, -1, -1);
+	(void)close(fds[0]);
+	if (dup2(fds[1], STDOUT_FILENO) == -1)
+		perror(TOOL_NAME ": dup2");
+	(void)close(fds[1]);
+	(void)atexit(dedup_end);
+}
+
+void dedup_end(void)
+{
+	if (-1 == filter_pid)
+		return;
+	(void)fflush(stdout);
+	(void)close(STDOUT_FILENO);
+	(void)wait_child(filter_pid);
+	filter_pid = -1;
+}
+
+int dedup_stats(char const *path, FILE * out)
+{
+	struct dedup_table *table;
+
+	errno = 0;
+	table = map_table(path, 0);
+	if (NULL == table) {
+		fprintf(stderr, TOOL_NAME ": %s: %s\n", path,
+			(0 == errno) ? "not a table" : strerror(errno));
+		return EXIT_FAILURE;
+	}
+	fprintf(out, "%lu diagnostics printed, %lu duplicates suppressed\n",
+		table->printed, table->suppressed);
+	(void)munmap((void *)table, sizeof(*table));
+	return (fflush(out) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
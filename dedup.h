@@ -0,0 +1,37 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_DEDUP_H_
+#define LCI_INC_DEDUP_H_
+#else
+#error "LCI_INC_DEDUP_H_"
+#endif
+
+/*
+ * Build wide suppression of repeated lint diagnostics.  With LCI_DEDUP
+ * naming a file, the output of lint goes through a table of diagnostic
+ * fingerprints mapped from that file by all lci processes of the build,
+ * and a diagnostic some lci already printed is dropped together with the
+ * source lines lint printed before it.  Remove the file to start over.
+ */
+
+extern char const *dedup_path(void);
+extern int dedup_fingerprint(char const *line, unsigned long *fingerprint);
+extern void dedup_begin(char const *path);
+extern void dedup_end(void);
+extern int dedup_stats(char const *path, FILE * out);
@@ -16,25 +16,119 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * A fake tool is a load generator too, set by the environment:
+ *
+ * FAKE_LATENCY_MS   sleep this long
+ * FAKE_CPU_MS       burn this much CPU time
+ * FAKE_MEMORY_KB    allocate and touch this much memory
+ * FAKE_OUTPUT_LINES print this many lint like diagnostics
+ * FAKE_EXIT         exit with this code
+ * FAKE_QUIET        do not print the argv
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 static int is_only_known_lint_options(int argc, char *argv[])
 {
 	return 1;
 }
 
+static long fake_setting(char const *name)
+{
+	char const *const value = getenv(name);
+	return (value != NULL) ? atol(value) : 0L;
+}
+
+static void fake_sleep(long ms)
+{
+	struct timespec ts;
+
+	if (ms <= 0)
+		return;
+	ts.tv_sec = ms / 1000L;
+	ts.tv_nsec = (ms % 1000L) * 1000000L;
+	while (nanosleep(&ts, &ts) != 0) ;
+}
+
+static void fake_burn(long ms)
+{
+	volatile unsigned long spin = 0;
+	clock_t end;
+
+	if (ms <= 0)
+		return;
+	end = clock() + (clock_t)(ms * (CLOCKS_PER_SEC / 1000L));
+	while (clock() < end)
+		++spin;
+}
+
+/*
+ * Every page touched, so the memory is really used
+ */
+static char *fake_memory(long kb)
+{
+	char *mem;
+
+	if (kb <= 0)
+		return NULL;
+	mem = (char *)malloc((size_t)kb * 1024u);
+	if (mem != NULL)
+		memset(mem, 1, (size_t)kb * 1024u);
+	return mem;
+}
+
+static char const *fake_source(int argc, char *argv[])
+{
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		size_t const len = strlen(argv[i]);
+		if (len > 2u && strcmp(&argv[i][len - 2u], ".c") == 0)
+			return argv[i];
+	}
+	return "fake.c";
+}
+
+static int fake_output(long lines, char const *source)
+{
+	long i;
+
+	for (i = 0; i < lines; ++i)
+		if (printf("%s  %ld  Info 765: external 'f%ld' could be made "
+			   "static\n", source, i + 1L, i) < 0)
+			return 0;
+	return 1;
+}
+
 int main(int argc, char *argv[])
 {
+	char *memory;
 	int i;
-	if (printf("This is `%s'\n", FAKE_TOOL_NAME) < 0)
-		return EXIT_FAILURE;
-	for (i = 0; i != argc; ++i)
-		if (printf("argv[%d]: `%s'\n", i, argv[i]) < 0)
+
+	memory = fake_memory(fake_setting("FAKE_MEMORY_KB"));
+	fake_burn(fake_setting("FAKE_CPU_MS"));
+	fake_sleep(fake_setting("FAKE_LATENCY_MS"));
+	if (NULL == getenv("FAKE_QUIET")) {
+		if (printf("This is `%s'\n", FAKE_TOOL_NAME) < 0)
+			return EXIT_FAILURE;
+		for (i = 0; i != argc; ++i)
+			if (printf("argv[%d]: `%s'\n", i, argv[i]) < 0)
+				return EXIT_FAILURE;
+		if (printf("End of `%s'\n", FAKE_TOOL_NAME) < 0)
 			return EXIT_FAILURE;
-	if (printf("End of `%s'\n", FAKE_TOOL_NAME) < 0)
+	}
+	if (!fake_output(fake_setting("FAKE_OUTPUT_LINES"),
+			 fake_source(argc, argv)))
 		return EXIT_FAILURE;
+	free(memory);
 	if (!is_only_known_lint_options(argc, argv))
 		return EXIT_FAILURE;
-	return EXIT_SUCCESS;
+	return (getenv("FAKE_EXIT") != NULL) ?
+	    (int)fake_setting("FAKE_EXIT") : EXIT_SUCCESS;
 }
@@ -0,0 +1,223 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define MASK32 0xFFFFFFFFUL
+
+#define F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | (~(z) & MASK32)))
+
+#define ROTL(x, n) ((((x) << (n)) | ((x) >> (32 - (n)))) & MASK32)
+
+#define STEP(f, a, b, c, d, x, t, s) \
+	(a) = ((a) + f((b), (c), (d)) + (x) + (t)) & MASK32; \
+	(a) = (ROTL((a), (s)) + (b)) & MASK32
+
+static void transform(unsigned long abcd[4], unsigned char const block[64])
+{
+	unsigned long x[16];
+	unsigned long a = abcd[0];
+	unsigned long b = abcd[1];
+	unsigned long c = abcd[2];
+	unsigned long d = abcd[3];
+	int i;
+
+	for (i = 0; i != 16; ++i)
+		x[i] = (unsigned long)block[4 * i] |
+		    ((unsigned long)block[4 * i + 1] << 8) |
+		    ((unsigned long)block[4 * i + 2] << 16) |
+		    ((unsigned long)block[4 * i + 3] << 24);
+
+	STEP(F, a, b, c, d, x[0], 0xd76aa478UL, 7);
+	STEP(F, d, a, b, c, x[1], 0xe8c7b756UL, 12);
+	STEP(F, c, d, a, b, x[2], 0x242070dbUL, 17);
+	STEP(F, b, c, d, a, x[3], 0xc1bdceeeUL, 22);
+	STEP(F, a, b, c, d, x[4], 0xf57c0fafUL, 7);
+	STEP(F, d, a, b, c, x[5], 0x4787c62aUL, 12);
+	STEP(F, c, d, a, b, x[6], 0xa8304613UL, 17);
+	STEP(F, b, c, d, a, x[7], 0xfd469501UL, 22);
+	STEP(F, a, b, c, d, x[8], 0x698098d8UL, 7);
+	STEP(F, d, a, b, c, x[9], 0x8b44f7afUL, 12);
+	STEP(F, c, d, a, b, x[10], 0xffff5bb1UL, 17);
+	STEP(F, b, c, d, a, x[11], 0x895cd7beUL, 22);
+	STEP(F, a, b, c, d, x[12], 0x6b901122UL, 7);
+	STEP(F, d, a, b, c, x[13], 0xfd987193UL, 12);
+	STEP(F, c, d, a, b, x[14], 0xa679438eUL, 17);
+	STEP(F, b, c, d, a, x[15], 0x49b40821UL, 22);
+
+	STEP(G, a, b, c, d, x[1], 0xf61e2562UL, 5);
+	STEP(G, d, a, b, c, x[6], 0xc040b340UL, 9);
+	STEP(G, c, d, a, b, x[11], 0x265e5a51UL, 14);
+	STEP(G, b, c, d, a, x[0], 0xe9b6c7aaUL, 20);
+	STEP(G, a, b, c, d, x[5], 0xd62f105dUL, 5);
+	STEP(G, d, a, b, c, x[10], 0x02441453UL, 9);
+	STEP(G, c, d, a, b, x[15], 0xd8a1e681UL, 14);
+	STEP(G, b, c, d, a, x[4], 0xe7d3fbc8UL, 20);
+	STEP(G, a, b, c, d, x[9], 0x21e1cde6UL, 5);
+	STEP(G, d, a, b, c, x[14], 0xc33707d6UL, 9);
+	STEP(G, c, d, a, b, x[3], 0xf4d50d87UL, 14);
+	STEP(G, b, c, d, a, x[8], 0x455a14edUL, 20);
+	STEP(G, a, b, c, d, x[13], 0xa9e3e905UL, 5);
+	STEP(G, d, a, b, c, x[2], 0xfcefa3f8UL, 9);
+	STEP(G, c, d, a, b, x[7], 0x676f02d9UL, 14);
+	STEP(G, b, c, d, a, x[12], 0x8d2a4c8aUL, 20);
+
+	STEP(H, a, b, c, d, x[5], 0xfffa3942UL, 4);
+	STEP(H, d, a, b, c, x[8], 0x8771f681UL, 11);
+	STEP(H, c, d, a, b, x[11], 0x6d9d6122UL, 16);
+	STEP(H, b, c, d, a, x[14], 0xfde5380cUL, 23);
+	STEP(H, a, b, c, d, x[1], 0xa4beea44UL, 4);
+	STEP(H, d, a, b, c, x[4], 0x4bdecfa9UL, 11);
+	STEP(H, c, d, a, b, x[7], 0xf6bb4b60UL, 16);
+	STEP(H, b, c, d, a, x[10], 0xbebfbc70UL, 23);
+	STEP(H, a, b, c, d, x[13], 0x289b7ec6UL, 4);
+	STEP(H, d, a, b, c, x[0], 0xeaa127faUL, 11);
+	STEP(H, c, d, a, b, x[3], 0xd4ef3085UL, 16);
+	STEP(H, b, c, d, a, x[6], 0x04881d05UL, 23);
+	STEP(H, a, b, c, d, x[9], 0xd9d4d039UL, 4);
+	STEP(H, d, a, b, c, x[12], 0xe6db99e5UL, 11);
+	STEP(H, c, d, a, b, x[15], 0x1fa27cf8UL, 16);
+	STEP(H, b, c, d, a, x[2], 0xc4ac5665UL, 23);
+
+	STEP(I, a, b, c, d, x[0], 0xf4292244UL, 6);
+	STEP(I, d, a, b, c, x[7], 0x432aff97UL, 10);
+	STEP(I, c, d, a, b, x[14], 0xab9423a7UL, 15);
+	STEP(I, b, c, d, a, x[5], 0xfc93a039UL, 21);
+	STEP(I, a, b, c, d, x[12], 0x655b59c3UL, 6);
+	STEP(I, d, a, b, c, x[3], 0x8f0ccc92UL, 10);
+	STEP(I, c, d, a, b, x[10], 0xffeff47dUL, 15);
+	STEP(I, b, c, d, a, x[1], 0x85845dd1UL, 21);
+	STEP(I, a, b, c, d, x[8], 0x6fa87e4fUL, 6);
+	STEP(I, d, a, b, c, x[15], 0xfe2ce6e0UL, 10);
+	STEP(I, c, d, a, b, x[6], 0xa3014314UL, 15);
+	STEP(I, b, c, d, a, x[13], 0x4e0811a1UL, 21);
+	STEP(I, a, b, c, d, x[4], 0xf7537e82UL, 6);
+	STEP(I, d, a, b, c, x[11], 0xbd3af235UL, 10);
+	STEP(I, c, d, a, b, x[2], 0x2ad7d2bbUL, 15);
+	STEP(I, b, c, d, a, x[9], 0xeb86d391UL, 21);
+
+	abcd[0] = (abcd[0] + a) & MASK32;
+	abcd[1] = (abcd[1] + b) & MASK32;
+	abcd[2] = (abcd[2] + c) & MASK32;
+	abcd[3] = (abcd[3] + d) & MASK32;
+}
+
+void hash_init(struct hash_state *state)
+{
+	state->abcd[0] = 0x67452301UL;
+	state->abcd[1] = 0xefcdab89UL;
+	state->abcd[2] = 0x98badcfeUL;
+	state->abcd[3] = 0x10325476UL;
+	state->count_lo = 0;
+	state->count_hi = 0;
+}
+
+void hash_update(struct hash_state *state, void const *data, size_t size)
+{
+	unsigned char const *p = (unsigned char const *)data;
+	size_t used = (size_t) (state->count_lo & 0x3F);
+
+	state->count_lo = (state->count_lo + size) & MASK32;
+	if (state->count_lo < (size & MASK32))
+		++state->count_hi;
+	state->count_hi += (unsigned long)(size >> 16 >> 16);
+	if (used != 0) {
+		size_t const room = 64u - used;
+		if (size < room) {
+			memcpy(&state->block[used], p, size);
+			return;
+		}
+		memcpy(&state->block[used], p, room);
+		transform(state->abcd, state->block);
+		p += room;
+		size -= room;
+	}
+	for (; size >= 64u; p += 64, size -= 64u)
+		transform(state->abcd, p);
+	memcpy(state->block, p, size);
+}
+
+void hash_string(struct hash_state *state, char const *str)
+{
+	/*
+	 * include the terminator so that "ab" "c" differs from "a" "bc"
+	 */
+	hash_update(state, str, strlen(str) + 1u);
+}
+
+int hash_file(struct hash_state *state, char const *path)
+{
+	unsigned char buf[BUFSIZ];
+	FILE *f;
+	size_t n;
+	int ok;
+
+	f = fopen(path, "rb");
+	if (NULL == f)
+		return 0;
+	while ((n = fread(buf, 1u, sizeof(buf), f)) != 0)
+		hash_update(state, buf, n);
+	ok = !ferror(f);
+	(void)fclose(f);
+	return ok;
+}
+
+void hash_final(struct hash_state *state,
+		unsigned char digest[HASH_DIGEST_SIZE])
+{
+	static unsigned char const padding[64] = { 0x80 };
+	unsigned char bits[8];
+	unsigned long const lo = state->count_lo;
+	unsigned long const hi = state->count_hi;
+	size_t const used = (size_t) (lo & 0x3F);
+	int i;
+
+	bits[0] = (unsigned char)(lo << 3);
+	bits[1] = (unsigned char)(lo >> 5);
+	bits[2] = (unsigned char)(lo >> 13);
+	bits[3] = (unsigned char)(lo >> 21);
+	bits[4] = (unsigned char)((lo >> 29) | (hi << 3));
+	bits[5] = (unsigned char)(hi >> 5);
+	bits[6] = (unsigned char)(hi >> 13);
+	bits[7] = (unsigned char)(hi >> 21);
+	hash_update(state, padding, (used < 56u) ? 56u - used : 120u - used);
+	hash_update(state, bits, sizeof(bits));
+	for (i = 0; i != HASH_DIGEST_SIZE; ++i)
+		digest[i] = (unsigned char)(state->abcd[i / 4] >> (8 * (i % 4)));
+}
+
+void hash_final_hex(struct hash_state *state, char hex[HASH_HEX_SIZE])
+{
+	static char const digits[] = "0123456789abcdef";
+	unsigned char digest[HASH_DIGEST_SIZE];
+	int i;
+
+	hash_final(state, digest);
+	for (i = 0; i != HASH_DIGEST_SIZE; ++i) {
+		hex[2 * i] = digits[digest[i] >> 4];
+		hex[2 * i + 1] = digits[digest[i] & 0xF];
+	}
+	hex[2 * HASH_DIGEST_SIZE] = '\0';
+}
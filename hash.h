@@ -0,0 +1,46 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_HASH_H_
+#define LCI_INC_HASH_H_
+#else
+#error "LCI_INC_HASH_H_"
+#endif
+
+/*
+ * MD5 message digest (RFC 1321), used for cache keys and fingerprints
+ */
+
+#define HASH_DIGEST_SIZE 16
+#define HASH_HEX_SIZE (2 * HASH_DIGEST_SIZE + 1)
+
+struct hash_state {
+	unsigned long abcd[4];
+	unsigned long count_lo;	/*!< message length in bytes, low 32 bits */
+	unsigned long count_hi;	/*!< message length in bytes, high bits */
+	unsigned char block[64];
+};
+
+extern void hash_init(struct hash_state *state);
+extern void hash_update(struct hash_state *state, void const *data,
+			size_t size);
+extern void hash_string(struct hash_state *state, char const *str);
+extern int hash_file(struct hash_state *state, char const *path);
+extern void hash_final(struct hash_state *state,
+		       unsigned char digest[HASH_DIGEST_SIZE]);
+extern void hash_final_hex(struct hash_state *state, char hex[HASH_HEX_SIZE]);
@@ -0,0 +1,193 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jobserver.h"
+#include "util.h"
+
+static char const *last_option(char const *makeflags, char const *name)
+{
+	char const *found = NULL;
+	char const *p = makeflags;
+
+	while ((p = strstr(p, name)) != NULL) {
+		p += strlen(name);
+		found = p;
+	}
+	return found;
+}
+
+/*
+ * Make 4.4 passes --jobserver-auth=fifo:PATH or --jobserver-auth=R,W,
+ * older versions --jobserver-fds=R,W.  The last option given counts.
+ */
+int jobserver_parse(struct jobserver *js, char const *makeflags)
+{
+	char const *value;
+	size_t len;
+
+	js->read_fd = -1;
+	js->write_fd = -1;
+	js->fifo = NULL;
+	js->own_read_fd = 0;
+	js->has_token = 0;
+	if (NULL == makeflags)
+		return 0;
+	value = last_option(makeflags, "--jobserver-auth=");
+	if (NULL == value)
+		value = last_option(makeflags, "--jobserver-fds=");
+	if (NULL == value)
+		return 0;
+	len = strcspn(value, " \t");
+	if (strncmp(value, "fifo:", 5u) == 0 && len > 5u) {
+		js->fifo = (char *)xmalloc(len - 5u + 1u);
+		memcpy(js->fifo, value + 5, len - 5u);
+		js->fifo[len - 5u] = '\0';
+		return 1;
+	}
+	if (sscanf(value, "%d,%d", &js->read_fd, &js->write_fd) != 2 ||
+	    js->read_fd < 0 || js->write_fd < 0) {
+		js->read_fd = -1;
+		js->write_fd = -1;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * The pipe of make is shared with the other clients, setting O_NONBLOCK
+ * on it would affect them.  A new open file description of the read end
+ * is ours alone.
+ */
+static void reopen_nonblocking(struct jobserver *js)
+{
+	char path[32];
+	int fd;
+
+	(void)sprintf(path, "/proc/self/fd/%d", js->read_fd);
+	fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (-1 == fd) {
+		log_puts(LCI_SEV_DEBUG, "jobserver pipe read may block\n");
+		return;
+	}
+	js->read_fd = fd;
+	js->own_read_fd = 1;
+}
+
+void jobserver_open(struct jobserver *js)
+{
+	if (!jobserver_parse(js, getenv("MAKEFLAGS")))
+		return;
+	if (js->fifo != NULL) {
+		/*
+		 * own open file descriptions, O_NONBLOCK affects no one else
+		 */
+		js->read_fd = open(js->fifo, O_RDONLY | O_NONBLOCK);
+		js->write_fd = open(js->fifo, O_WRONLY);
+		if (js->read_fd != -1)
+			(void)fcntl(js->read_fd, F_SETFD, FD_CLOEXEC);
+		if (js->write_fd != -1)
+			(void)fcntl(js->write_fd, F_SETFD, FD_CLOEXEC);
+	}
+	if (js->read_fd == -1 || js->write_fd == -1 ||
+	    fcntl(js->read_fd, F_GETFD) == -1 ||
+	    fcntl(js->write_fd, F_GETFD) == -1) {
+		/*
+		 * make closes the pipe for commands it does not consider
+		 * recursive, then there is nothing to limit us
+		 */
+		log_puts(LCI_SEV_INFORMATIONAL, "jobserver not available\n");
+		jobserver_close(js);
+		return;
+	}
+	if (NULL == js->fifo)
+		reopen_nonblocking(js);
+	log_printf(LCI_SEV_DEBUG, ("jobserver %d,%d\n", js->read_fd,
+		   js->write_fd));
+}
+
+/*
+ * Does not block, returns 0 when all tokens are in use.  Without a
+ * jobserver there is no limit and 1 is returned.  Only when the pipe
+ * could not be reopened non-blocking, a token another client takes
+ * between poll and read makes the read wait for the next one.
+ */
+int jobserver_try_acquire(struct jobserver *js)
+{
+	struct pollfd pfd;
+	ssize_t n;
+
+	if (-1 == js->read_fd)
+		return 1;
+	if (js->has_token)
+		return 1;
+	pfd.fd = js->read_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN))
+		return 0;
+	do
+		n = read(js->read_fd, &js->token, 1u);
+	while (-1 == n && EINTR == errno);
+	js->has_token = (1 == n);
+	log_printf(LCI_SEV_DEBUG, ("jobserver token %s\n",
+		   js->has_token ? "acquired" : "busy"));
+	return js->has_token;
+}
+
+void jobserver_release(struct jobserver *js)
+{
+	ssize_t n;
+
+	if (!js->has_token)
+		return;
+	do
+		n = write(js->write_fd, &js->token, 1u);
+	while (-1 == n && EINTR == errno);
+	if (n != 1)
+		perror(TOOL_NAME ": jobserver");
+	js->has_token = 0;
+	log_puts(LCI_SEV_DEBUG, "jobserver token released\n");
+}
+
+void jobserver_close(struct jobserver *js)
+{
+	jobserver_release(js);
+	if (js->fifo != NULL) {
+		if (js->read_fd != -1)
+			(void)close(js->read_fd);
+		if (js->write_fd != -1)
+			(void)close(js->write_fd);
+		free(js->fifo);
+		js->fifo = NULL;
+	} else if (js->own_read_fd) {
+		(void)close(js->read_fd);
+	}
+	js->own_read_fd = 0;
+	js->read_fd = -1;
+	js->write_fd = -1;
+}
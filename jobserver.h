@@ -0,0 +1,43 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_JOBSERVER_H_
+#define LCI_INC_JOBSERVER_H_
+#else
+#error "LCI_INC_JOBSERVER_H_"
+#endif
+
+/*
+ * GNU make jobserver client.  lci runs in a job slot of its own, a token
+ * is only needed for a process run besides the compiler.
+ */
+
+struct jobserver {
+	int read_fd;		/*!< -1 when there is no jobserver */
+	int write_fd;
+	char *fifo;		/*!< fifo path of --jobserver-auth=fifo:PATH */
+	int own_read_fd;	/*!< read_fd is our non-blocking reopen */
+	int has_token;
+	char token;
+};
+
+extern int jobserver_parse(struct jobserver *js, char const *makeflags);
+extern void jobserver_open(struct jobserver *js);
+extern int jobserver_try_acquire(struct jobserver *js);
+extern void jobserver_release(struct jobserver *js);
+extern void jobserver_close(struct jobserver *js);
@@ -0,0 +1,102 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * lci-log, prints the binary records LCI_LOG collects as text, one line
+ * per record with time, pid and severity
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util.h"
+
+#define LOG_NAME "lci-log"
+
+static char const *const severity_names[] = {
+	"emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+static void print_record(struct log_record const *rec, char const *text)
+{
+	time_t const sec = (time_t)rec->sec;
+	struct tm tm;
+	char stamp[32];
+	size_t len = rec->len;
+
+	if (NULL == localtime_r(&sec, &tm) ||
+	    0 == strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm))
+		(void)strcpy(stamp, "?");
+	while (len != 0 && '\n' == text[len - 1u])
+		--len;
+	printf("%s.%06ld %ld %s %.*s\n", stamp, rec->nsec / 1000L, rec->pid,
+	       (rec->severity <= LCI_SEV_DEBUG) ?
+	       severity_names[rec->severity] : "?", (int)len, text);
+}
+
+static int decode(FILE * in, char const *name)
+{
+	char text[LOG_MAX_TEXT];
+	struct log_record rec;
+
+	while (fread(&rec, sizeof(rec), 1u, in) == 1u) {
+		if (rec.magic != LOG_RECORD_MAGIC || rec.len > LOG_MAX_TEXT ||
+		    fread(text, 1u, rec.len, in) != rec.len) {
+			fprintf(stderr, LOG_NAME ": %s: not a log\n", name);
+			return 0;
+		}
+		print_record(&rec, text);
+	}
+	return !ferror(in);
+}
+
+int main(int argc, char *argv[])
+{
+	int ok = 1;
+	int i;
+
+	if (argc > 1 && '-' == argv[1][0] && argv[1][1] != '\0') {
+		fputs("usage: " LOG_NAME " [log file...]\n"
+		      "    prints LCI_LOG records, standard input without"
+		      " files\n", stderr);
+		return EXIT_FAILURE;
+	}
+	if (argc < 2)
+		ok = decode(stdin, "stdin");
+	for (i = 1; i < argc; ++i) {
+		FILE *in = strcmp(argv[i], "-") == 0 ? stdin :
+		    fopen(argv[i], "rb");
+
+		if (NULL == in) {
+			fprintf(stderr, LOG_NAME ": %s: %s\n", argv[i],
+				strerror(errno));
+			ok = 0;
+			continue;
+		}
+		ok = decode(in, argv[i]) && ok;
+		if (in != stdin)
+			(void)fclose(in);
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,390 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "hash.h"
+#include "manifest.h"
+#include "util.h"
+
+#define MAX_MANIFEST_LINE 8192
+
+static unsigned long string_hash(char const *str, size_t len)
+{
+	unsigned long h = 2166136261UL;
+	size_t i;
+
+	for (i = 0; i != len; ++i)
+		h = ((h ^ (unsigned char)str[i]) * 16777619UL) & 0xFFFFFFFFUL;
+	return h;
+}
+
+static void insert_file(struct manifest_scan *scan, char *path)
+{
+	size_t i;
+
+	i = string_hash(path, strlen(path)) & (scan->capacity - 1u);
+	while (scan->files[i] != NULL) {
+		if (strcmp(scan->files[i], path) == 0) {
+			free(path);
+			return;
+		}
+		i = (i + 1u) & (scan->capacity - 1u);
+	}
+	scan->files[i] = path;
+	++scan->count;
+}
+
+static void grow_files(struct manifest_scan *scan)
+{
+	char **old = scan->files;
+	size_t const old_capacity = scan->capacity;
+	size_t i;
+
+	scan->capacity *= 2u;
+	scan->files = (char **)xmalloc(scan->capacity * sizeof(char *));
+	for (i = 0; i != scan->capacity; ++i)
+		scan->files[i] = NULL;
+	scan->count = 0;
+	for (i = 0; i != old_capacity; ++i)
+		if (old[i] != NULL)
+			insert_file(scan, old[i]);
+	free(old);
+}
+
+static void add_file(struct manifest_scan *scan, char *path)
+{
+	if (2u * (scan->count + 1u) > scan->capacity)
+		grow_files(scan);
+	insert_file(scan, path);
+}
+
+void manifest_scan_init(struct manifest_scan *scan)
+{
+	size_t i;
+
+	scan->capacity = 64u;
+	scan->files = (char **)xmalloc(scan->capacity * sizeof(char *));
+	for (i = 0; i != scan->capacity; ++i)
+		scan->files[i] = NULL;
+	scan->count = 0;
+	scan->line_size = 256u;
+	scan->line = (char *)xmalloc(scan->line_size);
+	scan->line_len = 0;
+	scan->at_line_start = 1;
+	scan->in_marker = 0;
+}
+
+void manifest_scan_free(struct manifest_scan *scan)
+{
+	size_t i;
+
+	for (i = 0; i != scan->capacity; ++i)
+		free(scan->files[i]);
+	free(scan->files);
+	free(scan->line);
+	scan->files = NULL;
+	scan->line = NULL;
+}
+
+/*
+ * Returns the file name of a line marker, '# 12 "file" 2' or
+ * '#line 12 "file"', or NULL for other directives and pseudo files
+ * like <built-in>
+ */
+char *parse_line_marker(char const *line)
+{
+	char *path;
+	char const *p = line;
+	size_t len = 0;
+
+	if (*p++ != '#')
+		return NULL;
+	while (' ' == *p || '\t' == *p)
+		++p;
+	if (strncmp(p, "line", 4u) == 0)
+		p += 4;
+	while (' ' == *p || '\t' == *p)
+		++p;
+	if (*p < '0' || *p > '9')
+		return NULL;
+	while (*p >= '0' && *p <= '9')
+		++p;
+	while (' ' == *p || '\t' == *p)
+		++p;
+	if (*p++ != '"' || '<' == *p)
+		return NULL;
+	path = (char *)xmalloc(strlen(p) + 1u);
+	for (; *p != '"'; ++p) {
+		if ('\0' == *p) {
+			free(path);
+			return NULL;
+		}
+		if ('\\' == *p && p[1] != '\0')
+			++p;
+		path[len++] = *p;
+	}
+	path[len] = '\0';
+	if (0 == len) {
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
+static void end_marker(struct manifest_scan *scan)
+{
+	char *path;
+
+	scan->line[scan->line_len] = '\0';
+	path = parse_line_marker(scan->line);
+	if (path != NULL)
+		add_file(scan, path);
+	scan->in_marker = 0;
+	scan->line_len = 0;
+}
+
+void manifest_scan_feed(struct manifest_scan *scan, char const *buf,
+			size_t size)
+{
+	char const *const end = buf + size;
+	char const *p = buf;
+
+	while (p != end) {
+		char const *nl;
+
+		if (scan->at_line_start && !scan->in_marker) {
+			scan->at_line_start = 0;
+			if (*p != '#') {
+				nl = (char const *)memchr(p, '\n',
+							  (size_t)(end - p));
+				if (NULL == nl)
+					return;
+				p = nl + 1;
+				scan->at_line_start = 1;
+				continue;
+			}
+			scan->in_marker = 1;
+		}
+		if (!scan->in_marker) {
+			/*
+			 * rest of an ordinary line split over two buffers
+			 */
+			nl = (char const *)memchr(p, '\n', (size_t)(end - p));
+			if (NULL == nl)
+				return;
+			p = nl + 1;
+			scan->at_line_start = 1;
+			continue;
+		}
+		nl = (char const *)memchr(p, '\n', (size_t)(end - p));
+		if (NULL == nl)
+			nl = end;
+		if (scan->line_len + (size_t)(nl - p) + 1u > scan->line_size) {
+			scan->line_size =
+			    2u * (scan->line_len + (size_t)(nl - p) + 1u);
+			scan->line =
+			    (char *)xrealloc(scan->line, scan->line_size);
+		}
+		memcpy(&scan->line[scan->line_len], p, (size_t)(nl - p));
+		scan->line_len += (size_t)(nl - p);
+		if (nl == end)
+			return;
+		end_marker(scan);
+		p = nl + 1;
+		scan->at_line_start = 1;
+	}
+}
+
+/*
+ * Reads a make rule written by the compiler with -MD.  Targets end with a
+ * colon and are skipped, with -MP the headers are also targets of their
+ * own empty rules.  Backslash escapes a space, a hash or a newline, $$ is
+ * a dollar sign.
+ */
+int manifest_scan_depfile(struct manifest_scan *scan, char const *path)
+{
+	char *text = NULL;
+	char *word;
+	size_t size = 0;
+	size_t len = 0;
+	size_t i = 0;
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (NULL == f)
+		return 0;
+	do {
+		if (len + BUFSIZ + 1u > size) {
+			size = 2u * (len + BUFSIZ + 1u);
+			text = (char *)xrealloc(text, size);
+		}
+		n = fread(&text[len], 1u, BUFSIZ, f);
+		len += n;
+	} while (n != 0);
+	n = (size_t)ferror(f);
+	(void)fclose(f);
+	if (n != 0) {
+		free(text);
+		return 0;
+	}
+	text[len] = '\0';
+	word = (char *)xmalloc(len + 1u);
+	while (i != len) {
+		size_t w = 0;
+
+		while (i != len && (' ' == text[i] || '\t' == text[i] ||
+				    '\n' == text[i] || '\r' == text[i] ||
+				    ('\\' == text[i] && '\n' == text[i + 1])))
+			i += ('\\' == text[i]) ? 2u : 1u;
+		for (; i != len && text[i] != ' ' && text[i] != '\t' &&
+		     text[i] != '\n' && text[i] != '\r'; ++i) {
+			if ('\\' == text[i] && (' ' == text[i + 1] ||
+						'#' == text[i + 1]))
+				++i;
+			else if ('\\' == text[i] && '\n' == text[i + 1])
+				break;
+			else if ('$' == text[i] && '$' == text[i + 1])
+				++i;
+			word[w++] = text[i];
+		}
+		if (0 == w || ':' == word[w - 1])
+			continue;
+		word[w] = '\0';
+		add_file(scan, xstrdup(word));
+	}
+	free(word);
+	free(text);
+	return scan->count != 0;
+}
+
+static int file_matches_hash(char const *path, char const *expected)
+{
+	struct hash_state state;
+	char hex[HASH_HEX_SIZE];
+
+	hash_init(&state);
+	if (!hash_file(&state, path))
+		return 0;
+	hash_final_hex(&state, hex);
+	return strcmp(hex, expected) == 0;
+}
+
+/*
+ * Files modified after start may have changed while the preprocessor read
+ * them, no manifest is made for such translation units
+ */
+char *manifest_scan_render(struct manifest_scan *scan, time_t start)
+{
+	char *text;
+	size_t len = 0;
+	size_t size = 256u;
+	size_t i;
+
+	text = (char *)xmalloc(size);
+	text[0] = '\0';
+	for (i = 0; i != scan->capacity; ++i) {
+		struct hash_state state;
+		char hex[HASH_HEX_SIZE];
+		struct stat st;
+		char const *path = scan->files[i];
+		size_t need;
+
+		if (NULL == path)
+			continue;
+		hash_init(&state);
+		if (stat(path, &st) != 0 || st.st_mtime >= start ||
+		    st.st_ctime >= start || !hash_file(&state, path)) {
+			log_printf(LCI_SEV_INFORMATIONAL,(
+				   "no manifest because of %s\n", path));
+			free(text);
+			return NULL;
+		}
+		hash_final_hex(&state, hex);
+		need = len + strlen(path) + 4u * 21u + HASH_HEX_SIZE;
+		if (need > size) {
+			size = 2u * need;
+			text = (char *)xrealloc(text, size);
+		}
+		len += (size_t)sprintf(&text[len], "%lu %ld %ld %s %s\n",
+				       (unsigned long)st.st_size,
+				       (long)st.st_mtime, (long)st.st_ctime,
+				       hex, path);
+	}
+	return text;
+}
+
+static int file_unchanged(char *line)
+{
+	char hex[HASH_HEX_SIZE];
+	unsigned long size;
+	long mtime;
+	long ctime;
+	struct stat st;
+	char *nl;
+	int pos;
+
+	nl = strchr(line, '\n');
+	if (nl != NULL)
+		*nl = '\0';
+	if (sscanf(line, "%lu %ld %ld %32s %n", &size, &mtime, &ctime, hex,
+		   &pos) != 4)
+		return 0;
+	if (stat(&line[pos], &st) != 0 || (unsigned long)st.st_size != size)
+		return 0;
+	/*
+	 * mtime can be set back by the user, ctime can not.  A touched file
+	 * may still have the same content.
+	 */
+	if ((long)st.st_mtime == mtime && (long)st.st_ctime == ctime)
+		return 1;
+	return file_matches_hash(&line[pos], hex);
+}
+
+int manifest_lookup(char const *path, char key[HASH_HEX_SIZE])
+{
+	char *line;
+	FILE *f;
+	int ok;
+
+	f = fopen(path, "r");
+	if (NULL == f)
+		return 0;
+	line = (char *)xmalloc(MAX_MANIFEST_LINE);
+	ok = (fgets(line, MAX_MANIFEST_LINE, f) != NULL &&
+	      sscanf(line, MANIFEST_MAGIC " %32s", key) == 1 &&
+	      strlen(key) == HASH_HEX_SIZE - 1u);
+	while (ok && fgets(line, MAX_MANIFEST_LINE, f) != NULL)
+		ok = file_unchanged(line);
+	ok = ok && !ferror(f);
+	(void)fclose(f);
+	free(line);
+	log_printf(LCI_SEV_DEBUG, ("manifest %s %s\n", path,
+		   ok ? "matches" : "differs"));
+	return ok;
+}
@@ -0,0 +1,56 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_MANIFEST_H_
+#define LCI_INC_MANIFEST_H_
+#else
+#error "LCI_INC_MANIFEST_H_"
+#endif
+
+/*
+ * Direct mode manifests.  A manifest names every file a translation unit
+ * read, with size, mtime, ctime and content hash, and the result cache key it
+ * produced.  When all files still match, the key is known without running
+ * the preprocessor.
+ */
+
+#define MANIFEST_MAGIC "lci-manifest 1"
+
+/*
+ * Collects the files named by line markers in preprocessor output
+ */
+struct manifest_scan {
+	char **files;		/*!< open addressing set, capacity power of 2 */
+	size_t capacity;
+	size_t count;
+	char *line;		/*!< line marker being read */
+	size_t line_len;
+	size_t line_size;
+	int at_line_start;
+	int in_marker;
+};
+
+extern void manifest_scan_init(struct manifest_scan *scan);
+extern void manifest_scan_feed(struct manifest_scan *scan, char const *buf,
+			       size_t size);
+extern int manifest_scan_depfile(struct manifest_scan *scan,
+				 char const *path);
+extern char *manifest_scan_render(struct manifest_scan *scan, time_t start);
+extern void manifest_scan_free(struct manifest_scan *scan);
+extern char *parse_line_marker(char const *line);
+extern int manifest_lookup(char const *path, char key[HASH_HEX_SIZE]);
@@ -0,0 +1,414 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "output.h"
+#include "process.h"
+#include "util.h"
+
+#define SPLICE_CHUNK (64 * 1024)
+/*
+ * Lines of one writev in prefix and tag mode, two vectors per line
+ */
+#define LINES_PER_WRITE 64
+
+enum { OUT, ERR };
+
+/*
+ * Consecutive data of one stream in the memory file
+ */
+struct chunk {
+	int stream;
+	size_t len;
+};
+
+struct relay {
+	int pipe[2];
+	int write_end[2];
+	int dest[2];
+	char const *mode;
+	char const *unit;
+	int mem_fd;
+	struct chunk *chunks;
+	size_t count;
+	size_t capacity;
+	loff_t size;
+};
+
+static pid_t relay_pid = -1;
+static int saved_fd[2] = { -1, -1 };
+
+char const *output_mode(void)
+{
+	char const *mode = getenv("LCI_GROUP_OUTPUT");
+	return (mode != NULL && *mode != '\0') ? mode : NULL;
+}
+
+/*
+ * The first source file, else the output file, else the compiler
+ */
+char const *output_unit(int argc, char *argv[])
+{
+	char const *output = NULL;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (is_source_file(argv[i]))
+			return argv[i];
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[i + 1];
+	}
+	return (output != NULL) ? output : argv[0];
+}
+
+static int memory_file(void)
+{
+	char const *tmpdir = getenv("TMPDIR");
+	char *path;
+	int fd;
+
+#ifdef MFD_CLOEXEC
+	fd = memfd_create("lci-output", MFD_CLOEXEC);
+	if (fd != -1)
+		return fd;
+#endif
+	if (NULL == tmpdir || '\0' == *tmpdir)
+		tmpdir = "/tmp";
+	path = xjoin_path(tmpdir, "lci-output.XXXXXX");
+	fd = mkstemp(path);
+	if (fd != -1)
+		(void)unlink(path);
+	free(path);
+	return fd;
+}
+
+static void add_chunk(struct relay *r, int stream, size_t len)
+{
+	if (r->count != 0 && r->chunks[r->count - 1u].stream == stream) {
+		r->chunks[r->count - 1u].len += len;
+		return;
+	}
+	if (r->count == r->capacity) {
+		r->capacity = (0 == r->capacity) ? 16u : 2u * r->capacity;
+		r->chunks = (struct chunk *)xrealloc(r->chunks,
+						     r->capacity *
+						     sizeof(*r->chunks));
+	}
+	r->chunks[r->count].stream = stream;
+	r->chunks[r->count++].len = len;
+}
+
+/*
+ * Moves what is in the pipe to the memory file, without a copy through
+ * this process where the kernel can splice.  0 at end of file.
+ */
+static ssize_t take(struct relay *r, int stream)
+{
+	char buf[4096];
+	ssize_t n;
+
+	n = splice(r->pipe[stream], NULL, r->mem_fd, &r->size, SPLICE_CHUNK,
+		   SPLICE_F_MOVE);
+	if (-1 == n && EINVAL == errno) {
+		log_puts(LCI_SEV_DEBUG, "cannot splice output, copy it\n");
+		n = read(r->pipe[stream], buf, sizeof(buf));
+		if (n > 0 && pwrite(r->mem_fd, buf, (size_t)n, r->size) != n)
+			n = -1;
+		if (n > 0)
+			r->size += n;
+	}
+	if (n > 0)
+		add_chunk(r, stream, (size_t)n);
+	return n;
+}
+
+static void write_all(int fd, char const *data, size_t len)
+{
+	while (len != 0) {
+		ssize_t const n = write(fd, data, len);
+
+		if (n <= 0 && EINTR != errno)
+			return;
+		if (n > 0) {
+			data += n;
+			len -= (size_t)n;
+		}
+	}
+}
+
+/*
+ * A chunk as it is, straight from the memory file
+ */
+static void send_chunk(struct relay *r, int fd, off_t off, size_t len)
+{
+	char *data;
+
+	while (len != 0) {
+		ssize_t const n = sendfile(fd, r->mem_fd, &off, len);
+
+		if (n <= 0)
+			break;
+		len -= (size_t)n;
+	}
+	if (0 == len)
+		return;
+	data = (char *)mmap(NULL, (size_t)off + len, PROT_READ, MAP_SHARED,
+			    r->mem_fd, 0);
+	if (MAP_FAILED == (void *)data)
+		return;
+	write_all(fd, data + off, len);
+	(void)munmap(data, (size_t)off + len);
+}
+
+/*
+ * A chunk line by line, each line after its prefix
+ */
+static void send_lines(int fd, char const *prefix, char *data, size_t len)
+{
+	struct iovec iov[2 * LINES_PER_WRITE];
+	size_t const prefix_len = strlen(prefix);
+	char newline[] = "\n";
+	int count = 0;
+
+	while (len != 0) {
+		char *const end = (char *)memchr(data, '\n', len);
+		size_t const line = (NULL == end) ? len :
+		    (size_t)(end - data) + 1u;
+
+		iov[count].iov_base = (void *)prefix;
+		iov[count++].iov_len = prefix_len;
+		iov[count].iov_base = data;
+		iov[count++].iov_len = line;
+		data += line;
+		len -= line;
+		if (0 == len && NULL == end) {
+			/*
+			 * the last line ends, so the next prefix starts one
+			 */
+			(void)writev(fd, iov, count);
+			write_all(fd, newline, 1u);
+			return;
+		}
+		if (count == 2 * LINES_PER_WRITE || 0 == len) {
+			(void)writev(fd, iov, count);
+			count = 0;
+		}
+	}
+}
+
+/*
+ * flock locks the open file description, which every lci of a build
+ * shares for its stdout, so the lock is taken on a new one.  Returns the
+ * locked descriptor, -1 when fd is the file of other, which is locked.
+ */
+static int lock(int fd, int other)
+{
+	char path[32];
+	struct stat a;
+	struct stat b;
+	int lock_fd;
+
+	if (other != -1 && fstat(fd, &a) == 0 && fstat(other, &b) == 0 &&
+	    a.st_dev == b.st_dev && a.st_ino == b.st_ino)
+		return -1;
+	(void)sprintf(path, "/proc/self/fd/%d", fd);
+	lock_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (-1 == lock_fd)
+		lock_fd = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+	while (flock(lock_fd, LOCK_EX) != 0 && EINTR == errno) ;
+	return lock_fd;
+}
+
+static void unlock(int lock_fd)
+{
+	if (-1 == lock_fd)
+		return;
+	(void)flock(lock_fd, LOCK_UN);
+	(void)close(lock_fd);
+}
+
+/*
+ * The block of the unit, stdout locked before stderr by every lci
+ */
+static void write_block(struct relay *r)
+{
+	int const tag = (strstr(r->mode, "tag") != NULL);
+	int const prefix = tag || (strstr(r->mode, "prefix") != NULL);
+	char *prefixes[2] = { NULL, NULL };
+	int locked[2];
+	char *data = NULL;
+	off_t off = 0;
+	size_t i;
+
+	if (0 == r->size)
+		return;
+	if (prefix) {
+		size_t const len = strlen(r->unit) + 8u;
+		int s;
+
+		data = (char *)mmap(NULL, (size_t)r->size, PROT_READ,
+				    MAP_SHARED, r->mem_fd, 0);
+		if (MAP_FAILED == (void *)data)
+			return;
+		for (s = OUT; s <= ERR; ++s) {
+			prefixes[s] = (char *)xmalloc(len);
+			if (tag)
+				(void)sprintf(prefixes[s], "%s\t%s\t",
+					      r->unit, (OUT == s) ? "out" :
+					      "err");
+			else
+				(void)sprintf(prefixes[s], "%s: ", r->unit);
+		}
+		if (tag)
+			r->dest[ERR] = r->dest[OUT];
+	}
+	locked[OUT] = lock(r->dest[OUT], -1);
+	locked[ERR] = lock(r->dest[ERR], r->dest[OUT]);
+	for (i = 0; i != r->count; ++i) {
+		struct chunk const *const c = &r->chunks[i];
+
+		if (prefix)
+			send_lines(r->dest[c->stream], prefixes[c->stream],
+				   data + off, c->len);
+		else
+			send_chunk(r, r->dest[c->stream], off, c->len);
+		off += (off_t)c->len;
+	}
+	unlock(locked[ERR]);
+	unlock(locked[OUT]);
+	if (prefix)
+		(void)munmap(data, (size_t)r->size);
+	free(prefixes[OUT]);
+	free(prefixes[ERR]);
+}
+
+static int run_relay(void *data)
+{
+	struct relay *const r = (struct relay *)data;
+	struct pollfd pfd[2];
+	int open_pipes = 2;
+
+	(void)close(r->write_end[OUT]);
+	(void)close(r->write_end[ERR]);
+	pfd[OUT].fd = r->pipe[OUT];
+	pfd[ERR].fd = r->pipe[ERR];
+	pfd[OUT].events = pfd[ERR].events = POLLIN;
+	while (open_pipes != 0) {
+		int s;
+
+		if (poll(pfd, 2, -1) == -1) {
+			if (EINTR == errno)
+				continue;
+			break;
+		}
+		for (s = OUT; s <= ERR; ++s) {
+			ssize_t n;
+
+			if (0 == pfd[s].revents)
+				continue;
+			n = take(r, s);
+			if (0 == n || (n < 0 && errno != EINTR)) {
+				pfd[s].fd = -1;
+				--open_pipes;
+			}
+		}
+	}
+	write_block(r);
+	return EXIT_SUCCESS;
+}
+
+void output_begin(char const *mode, char const *unit)
+{
+	struct relay r;
+	int out[2];
+	int err[2];
+
+	(void)fflush(NULL);
+	memset(&r, 0, sizeof(r));
+	r.mode = mode;
+	r.unit = unit;
+	r.mem_fd = memory_file();
+	if (-1 == r.mem_fd) {
+		perror(TOOL_NAME ": output");
+		return;
+	}
+	if (pipe(out) != 0) {
+		perror(TOOL_NAME ": output");
+		(void)close(r.mem_fd);
+		return;
+	}
+	if (pipe(err) != 0) {
+		perror(TOOL_NAME ": output");
+		(void)close(r.mem_fd);
+		(void)close(out[0]);
+		(void)close(out[1]);
+		return;
+	}
+	r.pipe[OUT] = out[0];
+	r.pipe[ERR] = err[0];
+	r.write_end[OUT] = out[1];
+	r.write_end[ERR] = err[1];
+	r.dest[OUT] = STDOUT_FILENO;
+	r.dest[ERR] = STDERR_FILENO;
+	relay_pid = start_function(run_relay, &r, -1, -1);
+	(void)close(r.mem_fd);
+	(void)close(out[0]);
+	(void)close(err[0]);
+	saved_fd[OUT] = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+	saved_fd[ERR] = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+	(void)dup2(out[1], STDOUT_FILENO);
+	(void)dup2(err[1], STDERR_FILENO);
+	(void)close(out[1]);
+	(void)close(err[1]);
+	(void)atexit(output_end);
+}
+
+/*
+ * The block is written once nothing writes to the pipes any more
+ */
+void output_end(void)
+{
+	if (-1 == relay_pid)
+		return;
+	(void)fflush(NULL);
+	(void)dup2(saved_fd[OUT], STDOUT_FILENO);
+	(void)dup2(saved_fd[ERR], STDERR_FILENO);
+	(void)close(saved_fd[OUT]);
+	(void)close(saved_fd[ERR]);
+	(void)wait_child(relay_pid);
+	relay_pid = -1;
+}
@@ -0,0 +1,37 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_OUTPUT_H_
+#define LCI_INC_OUTPUT_H_
+#else
+#error "LCI_INC_OUTPUT_H_"
+#endif
+
+/*
+ * Output of a translation unit in one block.  With LCI_GROUP_OUTPUT set,
+ * what lci, the compiler and lint print goes through pipes into a memory
+ * file and is written when lci is done, under a lock on stdout and
+ * stderr, so parallel builds do not interleave it.  A value with "prefix"
+ * starts each line with the unit, one with "tag" writes all lines to
+ * stdout as unit, tab, "out" or "err", tab and the line.
+ */
+
+extern char const *output_mode(void);
+extern char const *output_unit(int argc, char *argv[]);
+extern void output_begin(char const *mode, char const *unit);
+extern void output_end(void);
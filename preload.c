@@ -0,0 +1,283 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * liblci-preload.so, LD_PRELOAD it into a build tool to lint the compiles
+ * it runs without a directory of symbolic links.
+ *
+ * A compiler started with one of the exec functions or posix_spawn, as
+ * GNU make and ninja do, is started through the lci program, LCI_PROGRAM
+ * or lci found in PATH, with the compiler command line as arguments.  lci
+ * never runs in the process of the build tool, which may have vforked.
+ *
+ * So each compile still costs the exec of lci, as through a symbolic
+ * link.  What the library saves is the directory of links, not a process.
+ */
+
+#define _GNU_SOURCE
+
+#include <alloca.h>
+#include <dlfcn.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "util.h"
+
+#define DEFAULT_COMPILERS "cc c++ gcc g++ clang clang++"
+#define PRELOAD_VARIABLE "LD_PRELOAD="
+
+typedef int exec_fn(char const *path, char *const argv[], char *const envp[]);
+typedef int spawn_fn(pid_t * pid, char const *path,
+		     posix_spawn_file_actions_t const *actions,
+		     posix_spawnattr_t const *attr, char *const argv[],
+		     char *const envp[]);
+
+extern char **environ;
+
+/*
+ * Looked up when the library is loaded, a hook may run in a vforked child
+ * that must not take locks or allocate
+ */
+static exec_fn *next_execve = NULL;
+static exec_fn *next_execvpe = NULL;
+static spawn_fn *next_spawn = NULL;
+static spawn_fn *next_spawnp = NULL;
+
+/*
+ * Base name of this library, as LD_PRELOAD names it
+ */
+static char self_name[256] = "liblci-preload.so";
+
+static void *next_symbol(char const *name)
+{
+	void *sym = dlsym(RTLD_NEXT, name);
+
+	if (NULL == sym) {
+		fprintf(stderr, TOOL_NAME ": no %s after liblci-preload.so\n",
+			name);
+		abort();
+	}
+	return sym;
+}
+
+static void init_preload(void) __attribute__ ((constructor));
+
+static void init_preload(void)
+{
+	Dl_info info;
+
+	next_execve = (exec_fn *) next_symbol("execve");
+	next_execvpe = (exec_fn *) next_symbol("execvpe");
+	next_spawn = (spawn_fn *) next_symbol("posix_spawn");
+	next_spawnp = (spawn_fn *) next_symbol("posix_spawnp");
+	if (dladdr((void *)&init_preload, &info) != 0 &&
+	    info.dli_fname != NULL) {
+		char const *slash = strrchr(info.dli_fname, '/');
+		char const *name = (NULL == slash) ? info.dli_fname : slash + 1;
+
+		if (strlen(name) < sizeof(self_name))
+			(void)strcpy(self_name, name);
+	}
+}
+
+static int is_intercepted(char const *path)
+{
+	char const *list = getenv("LCI_COMPILERS");
+
+	if (NULL == path)
+		return 0;
+	return is_compiler_name(path, (NULL == list) ? DEFAULT_COMPILERS :
+				list);
+}
+
+static size_t count_strings(char *const vec[])
+{
+	size_t n;
+
+	for (n = 0; vec[n] != NULL; ++n) ;
+	return n;
+}
+
+/*
+ * lci argv in front of the compiler argv, the compiler named by path
+ */
+static void lci_argv(char **vec, char *lci, char const *path,
+		     char *const argv[])
+{
+	size_t const n = count_strings(argv);
+
+	vec[0] = lci;
+	vec[1] = (char *)path;
+	memcpy(&vec[2], &argv[1], sizeof(char *) * n);
+}
+
+/*
+ * Length of the LD_PRELOAD entry of envp, 0 for none
+ */
+static size_t preload_length(char *const envp[])
+{
+	size_t i;
+
+	for (i = 0; envp[i] != NULL; ++i)
+		if (strncmp(envp[i], PRELOAD_VARIABLE,
+			    sizeof(PRELOAD_VARIABLE) - 1u) == 0)
+			return strlen(envp[i]);
+	return 0;
+}
+
+/*
+ * The LD_PRELOAD entry in buf without this library, 0 when nothing else
+ * is preloaded
+ */
+static int strip_self(char const *entry, char *buf)
+{
+	char const *list = &entry[sizeof(PRELOAD_VARIABLE) - 1u];
+	char *p = buf + sizeof(PRELOAD_VARIABLE) - 1u;
+
+	memcpy(buf, PRELOAD_VARIABLE, sizeof(PRELOAD_VARIABLE) - 1u);
+	while (*list != '\0') {
+		size_t const n = strcspn(list, " :");
+		size_t base = n;
+
+		while (base != 0 && list[base - 1u] != '/')
+			--base;
+		if (n != 0 && (n - base != strlen(self_name) ||
+			       strncmp(&list[base], self_name, n - base) != 0)) {
+			if (p != buf + sizeof(PRELOAD_VARIABLE) - 1u)
+				*p++ = ':';
+			memcpy(p, list, n);
+			p += n;
+		}
+		list += n;
+		if (*list != '\0')
+			++list;
+	}
+	*p = '\0';
+	return p != buf + sizeof(PRELOAD_VARIABLE) - 1u;
+}
+
+/*
+ * lci and its children run without this library, other preloads stay
+ */
+static void without_preload(char **vec, char *buf, char *const envp[])
+{
+	size_t i;
+	size_t j = 0;
+
+	for (i = 0; envp[i] != NULL; ++i)
+		if (strncmp(envp[i], PRELOAD_VARIABLE,
+			    sizeof(PRELOAD_VARIABLE) - 1u) != 0)
+			vec[j++] = envp[i];
+		else if (strip_self(envp[i], buf))
+			vec[j++] = buf;
+	vec[j] = NULL;
+}
+
+static char *lci_program(void)
+{
+	char *lci = getenv("LCI_PROGRAM");
+
+	return (NULL == lci || '\0' == *lci) ? (char *)TOOL_NAME : lci;
+}
+
+/*
+ * Returns only when lci could not be started, like exec.  The vectors
+ * are on the stack, not the heap of a process that may have vforked.
+ */
+static int exec_lci(char const *path, char *const argv[], char *const envp[])
+{
+	char **const vec = (char **)alloca(sizeof(char *) *
+					   (count_strings(argv) + 2u));
+	char **const env = (char **)alloca(sizeof(char *) *
+					   (count_strings(envp) + 1u));
+	char *const buf = (char *)alloca(preload_length(envp) + 1u);
+
+	lci_argv(vec, lci_program(), path, argv);
+	without_preload(env, buf, envp);
+	return next_execvpe(vec[0], vec, env);
+}
+
+int execve(char const *path, char *const argv[], char *const envp[])
+{
+	/*
+	 * shells try each directory of PATH, only the one that works is run
+	 */
+	if (is_intercepted(path) && access(path, X_OK) == 0)
+		return exec_lci(path, argv, envp);
+	return next_execve(path, argv, envp);
+}
+
+int execv(char const *path, char *const argv[])
+{
+	return execve(path, argv, environ);
+}
+
+int execvpe(char const *file, char *const argv[], char *const envp[])
+{
+	if (is_intercepted(file))
+		return exec_lci(file, argv, envp);
+	return next_execvpe(file, argv, envp);
+}
+
+int execvp(char const *file, char *const argv[])
+{
+	return execvpe(file, argv, environ);
+}
+
+static int spawn_lci(pid_t * pid, char const *path,
+		     posix_spawn_file_actions_t const *actions,
+		     posix_spawnattr_t const *attr, char *const argv[],
+		     char *const envp[])
+{
+	char **const vec = (char **)alloca(sizeof(char *) *
+					   (count_strings(argv) + 2u));
+	char **const env = (char **)alloca(sizeof(char *) *
+					   (count_strings(envp) + 1u));
+	char *const buf = (char *)alloca(preload_length(envp) + 1u);
+
+	lci_argv(vec, lci_program(), path, argv);
+	without_preload(env, buf, envp);
+	return next_spawnp(pid, vec[0], actions, attr, vec, env);
+}
+
+int posix_spawn(pid_t * pid, char const *path,
+		posix_spawn_file_actions_t const *actions,
+		posix_spawnattr_t const *attr, char *const argv[],
+		char *const envp[])
+{
+	if (!is_intercepted(path))
+		return next_spawn(pid, path, actions, attr, argv, envp);
+	return spawn_lci(pid, path, actions, attr, argv, envp);
+}
+
+int posix_spawnp(pid_t * pid, char const *file,
+		 posix_spawn_file_actions_t const *actions,
+		 posix_spawnattr_t const *attr, char *const argv[],
+		 char *const envp[])
+{
+	if (!is_intercepted(file))
+		return next_spawnp(pid, file, actions, attr, argv, envp);
+	return spawn_lci(pid, file, actions, attr, argv, envp);
+}
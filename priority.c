@@ -0,0 +1,158 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "priority.h"
+#include "util.h"
+
+/*
+ * lint starts anyway after waiting this long, a busy build must finish
+ */
+#define MAX_IDLE_WAIT_MS 60000
+#define IDLE_POLL_MS 500
+
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+
+/*
+ * The value of an environment variable as a number, 0 when unset
+ */
+static double env_number(char const *name)
+{
+	char const *const value = getenv(name);
+	return (value != NULL) ? atof(value) : 0.0;
+}
+
+/*
+ * avg10 of the "some" line of /proc/pressure/cpu
+ */
+int parse_cpu_pressure(char const *line, double *avg10)
+{
+	return sscanf(line, "some avg10=%lf", avg10) == 1;
+}
+
+static int read_first_line(char const *path, char *line, int size)
+{
+	FILE *const f = fopen(path, "r");
+	int ok;
+
+	if (NULL == f)
+		return 0;
+	ok = (fgets(line, size, f) != NULL);
+	(void)fclose(f);
+	return ok;
+}
+
+int lint_system_busy(void)
+{
+	double const max_load = env_number("LCI_MAX_LOAD");
+	double const max_pressure = env_number("LCI_MAX_PRESSURE");
+	char line[256];
+	double value;
+
+	if (max_load > 0.0 && read_first_line("/proc/loadavg", line,
+					      (int)sizeof(line)) &&
+	    sscanf(line, "%lf", &value) == 1 && value > max_load) {
+		log_printf(LCI_SEV_DEBUG, ("load %.2f\n", value));
+		return 1;
+	}
+	if (max_pressure > 0.0 && read_first_line("/proc/pressure/cpu", line,
+						  (int)sizeof(line)) &&
+	    parse_cpu_pressure(line, &value) && value > max_pressure) {
+		log_printf(LCI_SEV_DEBUG, ("cpu pressure %.2f\n", value));
+		return 1;
+	}
+	return 0;
+}
+
+void lint_wait_for_idle(void)
+{
+	struct timespec const interval = {
+		IDLE_POLL_MS / 1000, (IDLE_POLL_MS % 1000) * 1000000L
+	};
+	int waited = 0;
+
+	while (lint_system_busy()) {
+		if (waited >= MAX_IDLE_WAIT_MS) {
+			log_puts(LCI_SEV_NOTICE, "system still busy, lint now\n");
+			return;
+		}
+		(void)nanosleep(&interval, NULL);
+		waited += IDLE_POLL_MS;
+	}
+	if (waited != 0)
+		log_printf(LCI_SEV_INFORMATIONAL, ("lint waited %d ms\n",
+			   waited));
+}
+
+static void join_cgroup(char const *dir)
+{
+	char *const procs = xjoin_path(dir, "cgroup.procs");
+	int const fd = open(procs, O_WRONLY | O_CLOEXEC);
+	char pid[24];
+	int const len = sprintf(pid, "%ld\n", (long)getpid());
+
+	if (-1 == fd || write(fd, pid, (size_t) len) != len)
+		log_printf(LCI_SEV_WARNING, ("cannot join %s: %s\n", dir,
+			   strerror(errno)));
+	if (fd != -1)
+		(void)close(fd);
+	free(procs);
+}
+
+/*
+ * Lowers the priority of lci itself before it starts lint, lint inherits
+ * it and a compile already started keeps its own
+ */
+void lint_lower_priority(void)
+{
+	static int lowered = 0;
+	char const *const cgroup = getenv("LCI_CGROUP");
+	int const steps = (int)env_number("LCI_NICE");
+
+	if (lowered)
+		return;
+	lowered = 1;
+	if (steps > 0) {
+		errno = 0;
+		if (setpriority(PRIO_PROCESS, 0,
+				getpriority(PRIO_PROCESS, 0) + steps) != 0)
+			log_printf(LCI_SEV_WARNING, ("setpriority: %s\n",
+				   strerror(errno)));
+#ifdef SYS_ioprio_set
+		(void)syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+			      IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+	}
+	if (cgroup != NULL && *cgroup != '\0')
+		join_cgroup(cgroup);
+}
@@ -0,0 +1,38 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_PRIORITY_H_
+#define LCI_INC_PRIORITY_H_
+#else
+#error "LCI_INC_PRIORITY_H_"
+#endif
+
+/*
+ * Lint on idle cycles, so it does not slow the compiles a link waits for.
+ * LCI_NICE lowers the CPU priority of lint by that many steps and puts it
+ * in the idle I/O class, LCI_CGROUP names a cgroup v2 directory, with a
+ * low cpu.weight, that lint is moved to.  lint is delayed while the one
+ * minute load average is above LCI_MAX_LOAD or the share of time some
+ * task waited for a CPU over the last ten seconds, in percent, is above
+ * LCI_MAX_PRESSURE.
+ */
+
+extern int parse_cpu_pressure(char const *line, double *avg10);
+extern int lint_system_busy(void);
+extern void lint_wait_for_idle(void);
+extern void lint_lower_priority(void);
@@ -0,0 +1,125 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "process.h"
+#include "trace.h"
+#include "util.h"
+
+extern char **environ;
+
+static void redirect(int fd, int to_fd)
+{
+	if (fd != -1 && fd != to_fd)
+		if (dup2(fd, to_fd) == -1) {
+			perror(TOOL_NAME ": dup2");
+			_exit(EXIT_FAILURE);
+		}
+}
+
+static int fail(void *data)
+{
+	(void)data;
+	return EXIT_FAILURE;
+}
+
+/*
+ * posix_spawn does not copy the page tables of lci like fork does.  When
+ * the program can not be started the error is reported here and a child
+ * that fails is returned, as if execvp had failed in a forked child.
+ */
+pid_t start_child(char *argv[], int out_fd, int err_fd)
+{
+	posix_spawn_file_actions_t actions;
+	pid_t cpid;
+	int err;
+
+	err = posix_spawn_file_actions_init(&actions);
+	if (0 == err && out_fd != -1 && out_fd != STDOUT_FILENO)
+		err = posix_spawn_file_actions_adddup2(&actions, out_fd,
+						       STDOUT_FILENO);
+	if (0 == err && err_fd != -1 && err_fd != STDERR_FILENO)
+		err = posix_spawn_file_actions_adddup2(&actions, err_fd,
+						       STDERR_FILENO);
+	if (0 == err)
+		err = posix_spawnp(&cpid, argv[0], &actions, NULL, &argv[0],
+				   environ);
+	(void)posix_spawn_file_actions_destroy(&actions);
+	if (err != 0) {
+		fprintf(stderr, TOOL_NAME ": %s: %s\n", argv[0], strerror(err));
+		return start_function(fail, NULL, -1, -1);
+	}
+	log_printf(LCI_SEV_DEBUG, ("started %s as %ld\n", argv[0], (long)cpid));
+	trace_started(cpid, argv[0]);
+	return cpid;
+}
+
+pid_t start_function(int (*run)(void *), void *data, int out_fd, int err_fd)
+{
+	pid_t cpid;
+
+	cpid = fork();
+	if (-1 == cpid) {
+		perror(TOOL_NAME ": fork");
+		exit(EXIT_FAILURE);
+	}
+	if (0 == cpid) {
+		int code;
+
+		log_forked();
+		redirect(out_fd, STDOUT_FILENO);
+		redirect(err_fd, STDERR_FILENO);
+		code = run(data);
+		(void)fflush(NULL);
+		log_flush();
+		_exit(code);
+	}
+	return cpid;
+}
+
+int wait_child(pid_t cpid)
+{
+	struct rusage usage;
+	int status;
+	pid_t w;
+
+	do {
+		errno = 0;
+		w = wait4(cpid, &status, 0, &usage);
+	} while (-1 == w && EINTR == errno);
+	if (w != cpid) {
+		perror(TOOL_NAME ": wait4");
+		exit(EXIT_FAILURE);
+	}
+	trace_finished(cpid, status, &usage);
+	return status;
+}
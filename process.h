@@ -0,0 +1,35 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_PROCESS_H_
+#define LCI_INC_PROCESS_H_
+#else
+#error "LCI_INC_PROCESS_H_"
+#endif
+
+/*
+ * Start argv[0] with stdout and stderr redirected to out_fd and err_fd,
+ * -1 keeps the stream of the caller.
+ */
+extern pid_t start_child(char *argv[], int out_fd, int err_fd);
+/*
+ * Like start_child, but the child runs run(data) and exits with the result
+ */
+extern pid_t start_function(int (*run)(void *), void *data, int out_fd,
+			    int err_fd);
+extern int wait_child(pid_t cpid);
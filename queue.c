@@ -0,0 +1,451 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "process.h"
+#include "queue.h"
+#include "util.h"
+
+#define QUEUE_MAGIC "LQ1"
+
+/*
+ * Keeps each batch lint command line well below ARG_MAX
+ */
+#define BATCH_ARG_BYTES (128u * 1024u)
+
+struct buffer {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct queued_tu {
+	char *cwd;
+	char **opts;
+	char **srcs;
+	int nopts;
+	int nsrc;
+};
+
+static void append_field(struct buffer *buf, char const *field)
+{
+	size_t const len = strlen(field) + 1u;
+
+	if (buf->len + len > buf->size) {
+		buf->size = 2u * (buf->len + len);
+		buf->data = (char *)xrealloc(buf->data, buf->size);
+	}
+	memcpy(&buf->data[buf->len], field, len);
+	buf->len += len;
+}
+
+static void append_count(struct buffer *buf, int count)
+{
+	char num[24];
+
+	(void)sprintf(num, "%d", count);
+	append_field(buf, num);
+}
+
+char const *lint_queue_path(void)
+{
+	char const *path = getenv("LCI_QUEUE");
+	return (path != NULL && *path != '\0') ? path : NULL;
+}
+
+static int write_all(int fd, char const *data, size_t len)
+{
+	while (len != 0) {
+		ssize_t const n = write(fd, data, len);
+		if (-1 == n) {
+			if (EINTR == errno)
+				continue;
+			return 0;
+		}
+		data += n;
+		len -= (size_t) n;
+	}
+	return 1;
+}
+
+static int lock_file(int fd, short type)
+{
+	struct flock fl;
+
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = 0;
+	fl.l_len = 0;
+	while (fcntl(fd, F_SETLKW, &fl) == -1)
+		if (errno != EINTR)
+			return 0;
+	return 1;
+}
+
+/*
+ * Opens and locks the queue.  A flush renames the queue away, a writer
+ * that opened the old file retries with the new one.
+ */
+static int open_locked(char const *path)
+{
+	for (;;) {
+		struct stat fd_st;
+		struct stat path_st;
+		int const fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+
+		if (-1 == fd)
+			return -1;
+		if (!lock_file(fd, F_WRLCK) || fstat(fd, &fd_st) != 0) {
+			(void)close(fd);
+			return -1;
+		}
+		if (stat(path, &path_st) == 0 &&
+		    fd_st.st_ino == path_st.st_ino &&
+		    fd_st.st_dev == path_st.st_dev)
+			return fd;
+		(void)close(fd);
+	}
+}
+
+/*
+ * Returns 0 when nothing was queued, lint_argv then has to be linted
+ * directly
+ */
+int lint_queue_append(char const *path, char *lint_argv[])
+{
+	struct buffer rec = { NULL, 0, 0 };
+	char cwd[4096];
+	int nopts = 0;
+	int nsrc = 0;
+	int fd;
+	int ok;
+	int i;
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+		return 0;
+	for (i = 1; lint_argv[i] != NULL; ++i)
+		if (is_source_file(lint_argv[i]))
+			++nsrc;
+		else
+			++nopts;
+	if (0 == nsrc)
+		return 0;
+	append_field(&rec, QUEUE_MAGIC);
+	append_field(&rec, cwd);
+	append_count(&rec, nopts);
+	for (i = 1; lint_argv[i] != NULL; ++i)
+		if (!is_source_file(lint_argv[i]))
+			append_field(&rec, lint_argv[i]);
+	append_count(&rec, nsrc);
+	for (i = 1; lint_argv[i] != NULL; ++i)
+		if (is_source_file(lint_argv[i]))
+			append_field(&rec, lint_argv[i]);
+
+	fd = open_locked(path);
+	ok = (fd != -1) && write_all(fd, rec.data, rec.len);
+	if (fd != -1)
+		(void)close(fd);
+	free(rec.data);
+	if (!ok) {
+		log_printf(LCI_SEV_WARNING, ("cannot queue to %s: %s\n", path,
+			   strerror(errno)));
+		return 0;
+	}
+	log_printf(LCI_SEV_INFORMATIONAL, ("queued lint to %s\n", path));
+	return 1;
+}
+
+static char *next_field(char **p, char const *end)
+{
+	char *field = *p;
+	char *nul;
+
+	if (*p >= end)
+		return NULL;
+	nul = (char *)memchr(field, '\0', (size_t) (end - field));
+	if (NULL == nul)
+		return NULL;
+	*p = nul + 1;
+	return field;
+}
+
+static char **next_fields(char **p, char const *end, int *count)
+{
+	char **fields;
+	char *num = next_field(p, end);
+	int i;
+
+	if (NULL == num || sscanf(num, "%d", count) != 1 || *count < 0)
+		return NULL;
+	fields = (char **)xmalloc(sizeof(char *) * (size_t) (*count + 1));
+	for (i = 0; i != *count; ++i) {
+		fields[i] = next_field(p, end);
+		if (NULL == fields[i]) {
+			free(fields);
+			return NULL;
+		}
+	}
+	return fields;
+}
+
+static struct queued_tu *parse_queue(char *data, size_t len, size_t *count)
+{
+	struct queued_tu *tus = NULL;
+	size_t capacity = 0;
+	char const *const end = data + len;
+	char *p = data;
+	char *magic;
+
+	*count = 0;
+	while ((magic = next_field(&p, end)) != NULL) {
+		struct queued_tu tu;
+
+		if (strcmp(magic, QUEUE_MAGIC) != 0)
+			break;
+		tu.cwd = next_field(&p, end);
+		tu.opts = next_fields(&p, end, &tu.nopts);
+		tu.srcs = next_fields(&p, end, &tu.nsrc);
+		if (NULL == tu.cwd || NULL == tu.opts || NULL == tu.srcs) {
+			free(tu.opts);
+			break;
+		}
+		if (*count == capacity) {
+			capacity = (0 == capacity) ? 64u : 2u * capacity;
+			tus = (struct queued_tu *)xrealloc(tus, capacity *
+							   sizeof(*tus));
+		}
+		tus[(*count)++] = tu;
+	}
+	if (p < end)
+		log_puts(LCI_SEV_WARNING, "lint queue truncated\n");
+	return tus;
+}
+
+static int compare_options(struct queued_tu const *l,
+			   struct queued_tu const *r)
+{
+	int cmp = strcmp(l->cwd, r->cwd);
+	int i;
+
+	if (cmp != 0)
+		return cmp;
+	if (l->nopts != r->nopts)
+		return (l->nopts < r->nopts) ? -1 : 1;
+	for (i = 0; i != l->nopts; ++i) {
+		cmp = strcmp(l->opts[i], r->opts[i]);
+		if (cmp != 0)
+			return cmp;
+	}
+	return 0;
+}
+
+static int compare_sources(struct queued_tu const *l,
+			   struct queued_tu const *r)
+{
+	int i;
+
+	if (l->nsrc != r->nsrc)
+		return (l->nsrc < r->nsrc) ? -1 : 1;
+	for (i = 0; i != l->nsrc; ++i) {
+		int const cmp = strcmp(l->srcs[i], r->srcs[i]);
+		if (cmp != 0)
+			return cmp;
+	}
+	return 0;
+}
+
+/*
+ * Groups equal options and puts duplicate translation units next to
+ * each other
+ */
+static int compare_tus(void const *lhs, void const *rhs)
+{
+	struct queued_tu const *l = (struct queued_tu const *)lhs;
+	struct queued_tu const *r = (struct queued_tu const *)rhs;
+	int const cmp = compare_options(l, r);
+
+	return (cmp != 0) ? cmp : compare_sources(l, r);
+}
+
+static int run_batch(char *argv[])
+{
+	int status;
+
+	status = wait_child(start_child(argv, -1, -1));
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status);
+	return WIFSIGNALED(status) ? WTERMSIG(status) : EXIT_FAILURE;
+}
+
+/*
+ * Lints tus[0] to tus[n - 1], which have equal options, in as few runs
+ * as the argument size limit allows
+ */
+static int lint_group(char *lint, struct queued_tu *tus, size_t n)
+{
+	char **argv;
+	size_t nfiles = 0;
+	size_t prefix_bytes = 0;
+	size_t bytes;
+	size_t i;
+	int argc;
+	int code = EXIT_SUCCESS;
+	int j;
+
+	for (i = 0; i != n; ++i)
+		nfiles += (size_t) tus[i].nsrc;
+	argv = (char **)xmalloc(sizeof(char *) *
+				((size_t) tus[0].nopts + nfiles + 2u));
+	argv[0] = lint;
+	for (j = 0; j != tus[0].nopts; ++j) {
+		argv[j + 1] = tus[0].opts[j];
+		prefix_bytes += strlen(tus[0].opts[j]) + 1u + sizeof(char *);
+	}
+	if (chdir(tus[0].cwd) != 0) {
+		log_printf(LCI_SEV_ERROR, ("cannot lint in %s: %s\n",
+			   tus[0].cwd, strerror(errno)));
+		free(argv);
+		return EXIT_FAILURE;
+	}
+	argc = tus[0].nopts + 1;
+	bytes = prefix_bytes;
+	for (i = 0; i != n; ++i) {
+		if (i != 0 && compare_sources(&tus[i - 1], &tus[i]) == 0)
+			continue;
+		for (j = 0; j != tus[i].nsrc; ++j) {
+			size_t const more = strlen(tus[i].srcs[j]) + 1u +
+			    sizeof(char *);
+			if (bytes + more > BATCH_ARG_BYTES &&
+			    argc > tus[0].nopts + 1) {
+				argv[argc] = NULL;
+				if (run_batch(argv) != EXIT_SUCCESS)
+					code = EXIT_FAILURE;
+				argc = tus[0].nopts + 1;
+				bytes = prefix_bytes;
+			}
+			argv[argc++] = tus[i].srcs[j];
+			bytes += more;
+		}
+	}
+	argv[argc] = NULL;
+	if (run_batch(argv) != EXIT_SUCCESS)
+		code = EXIT_FAILURE;
+	free(argv);
+	return code;
+}
+
+static char *read_file(char const *path, size_t *len)
+{
+	struct stat st;
+	char *data;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (-1 == fd)
+		return NULL;
+	/*
+	 * wait for a writer that opened the queue before it was taken
+	 */
+	if (!lock_file(fd, F_RDLCK) || fstat(fd, &st) != 0) {
+		(void)close(fd);
+		return NULL;
+	}
+	data = (char *)xmalloc((size_t) st.st_size + 1u);
+	*len = 0;
+	while (*len < (size_t) st.st_size) {
+		ssize_t const n = read(fd, &data[*len],
+				       (size_t) st.st_size - *len);
+		if (n <= 0) {
+			if (-1 == n && EINTR == errno)
+				continue;
+			break;
+		}
+		*len += (size_t) n;
+	}
+	(void)close(fd);
+	return data;
+}
+
+int lint_queue_flush(char const *path, char *lint)
+{
+	struct queued_tu *tus;
+	size_t count;
+	size_t len;
+	size_t first;
+	size_t i;
+	char *taken;
+	char *data;
+	int code = EXIT_SUCCESS;
+
+	/*
+	 * take the queue, compiles from now on start a new one
+	 */
+	taken = (char *)xmalloc(strlen(path) + 32u);
+	(void)sprintf(taken, "%s.%ld", path, (long)getpid());
+	if (rename(path, taken) != 0) {
+		if (errno != ENOENT) {
+			perror(TOOL_NAME ": rename");
+			code = EXIT_FAILURE;
+		}
+		free(taken);
+		return code;
+	}
+	data = read_file(taken, &len);
+	if (NULL == data) {
+		perror(TOOL_NAME ": lint queue");
+		free(taken);
+		return EXIT_FAILURE;
+	}
+	/*
+	 * before lint_group changes directory, the path may be relative
+	 */
+	(void)unlink(taken);
+	free(taken);
+	tus = parse_queue(data, len, &count);
+	qsort(tus, count, sizeof(*tus), compare_tus);
+	for (first = 0; first != count; first = i) {
+		for (i = first + 1; i != count; ++i)
+			if (compare_options(&tus[first], &tus[i]) != 0)
+				break;
+		log_printf(LCI_SEV_INFORMATIONAL, ("batch of %lu in %s\n",
+			   (unsigned long)(i - first), tus[first].cwd));
+		if (lint_group(lint, &tus[first], i - first) != EXIT_SUCCESS)
+			code = EXIT_FAILURE;
+	}
+	for (i = 0; i != count; ++i) {
+		free(tus[i].opts);
+		free(tus[i].srcs);
+	}
+	free(tus);
+	free(data);
+	return code;
+}
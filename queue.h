@@ -0,0 +1,33 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_QUEUE_H_
+#define LCI_INC_QUEUE_H_
+#else
+#error "LCI_INC_QUEUE_H_"
+#endif
+
+/*
+ * Deferred batch lint.  Each compile appends its lint options and source
+ * files to the queue file named by LCI_QUEUE, and a flush lints all
+ * queued translation units with equal options in one lint run.
+ */
+
+extern char const *lint_queue_path(void);
+extern int lint_queue_append(char const *path, char *lint_argv[]);
+extern int lint_queue_flush(char const *path, char *lint);
@@ -0,0 +1,292 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "hash.h"
+#include "response.h"
+#include "util.h"
+
+/*
+ * Nesting deeper than this is taken as a loop of response files
+ */
+#define MAX_RESPONSE_DEPTH 16
+
+/*
+ * Lint command lines longer than this go in an indirect file
+ */
+#define LINT_ARG_BYTES (128u * 1024u)
+
+struct arg_vec {
+	char **vec;
+	int count;
+	int size;
+};
+
+static void push_arg(struct arg_vec *args, char *arg)
+{
+	if (args->count + 1 >= args->size) {
+		args->size = 2 * args->size + 16;
+		args->vec = (char **)xrealloc(args->vec,
+					      sizeof(char *) *
+					      (size_t)args->size);
+	}
+	args->vec[args->count++] = arg;
+	args->vec[args->count] = NULL;
+}
+
+/*
+ * GCC rules, white space separates arguments, single and double quotes
+ * group and a backslash escapes the next character.  The argument is
+ * unquoted in place and NUL terminated where it ended, which is past the
+ * mapped file only for a last argument without quotes; that one is copied.
+ */
+static char *next_arg(char **cursor, char *end)
+{
+	char *in = *cursor;
+	char *out;
+	char *arg;
+	char quote = '\0';
+
+	while (in != end && isspace((unsigned char)*in))
+		++in;
+	if (in == end)
+		return NULL;
+	arg = out = in;
+	while (in != end) {
+		if ('\\' == *in && in + 1 != end) {
+			++in;
+			*out++ = *in++;
+		} else if (quote != '\0') {
+			if (*in == quote)
+				quote = '\0';
+			else
+				*out++ = *in;
+			++in;
+		} else if ('\'' == *in || '"' == *in) {
+			quote = *in++;
+		} else if (isspace((unsigned char)*in)) {
+			break;
+		} else {
+			*out++ = *in++;
+		}
+	}
+	*cursor = (in == end) ? end : in + 1;
+	if (out == end) {
+		char *copy = (char *)xmalloc((size_t)(out - arg) + 1u);
+
+		memcpy(copy, arg, (size_t)(out - arg));
+		copy[out - arg] = '\0';
+		return copy;
+	}
+	*out = '\0';
+	return arg;
+}
+
+static int expand_file(struct arg_vec *args, char const *path, int depth);
+
+static void add_arg(struct arg_vec *args, char *arg, int depth)
+{
+	if ('@' == arg[0] && depth < MAX_RESPONSE_DEPTH &&
+	    expand_file(args, &arg[1], depth + 1))
+		return;
+	push_arg(args, arg);
+}
+
+/*
+ * The file is mapped privately for good, arguments point into it
+ */
+static int expand_file(struct arg_vec *args, char const *path, int depth)
+{
+	struct stat st;
+	char *map;
+	char *cursor;
+	char *end;
+	char *arg;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (-1 == fd)
+		return 0;
+	if (fstat(fd, &st) != 0) {
+		(void)close(fd);
+		return 0;
+	}
+	if (0 == st.st_size) {
+		(void)close(fd);
+		return 1;
+	}
+	map = (char *)mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (MAP_FAILED == map) {
+		log_printf(LCI_SEV_WARNING, ("cannot map %s: %s\n", path,
+			   strerror(errno)));
+		return 0;
+	}
+	cursor = map;
+	end = map + st.st_size;
+	while ((arg = next_arg(&cursor, end)) != NULL)
+		add_arg(args, arg, depth);
+	return 1;
+}
+
+/*
+ * Returns argv itself when there is nothing to expand.  A response file
+ * that can not be read stays an argument, as with GCC.
+ */
+char **expand_response_files(int *argc, char *argv[])
+{
+	struct arg_vec args = { NULL, 0, 0 };
+	int i;
+
+	for (i = 0; i != *argc; ++i)
+		if ('@' == argv[i][0])
+			break;
+	if (i == *argc)
+		return argv;
+	for (i = 0; i != *argc; ++i)
+		add_arg(&args, argv[i], 0);
+	*argc = args.count;
+	return args.vec;
+}
+
+static int write_text(char const *path, char const *text, size_t len)
+{
+	char *tmp;
+	int fd;
+	int ok;
+
+	tmp = (char *)xmalloc(strlen(path) + sizeof(".XXXXXX"));
+	(void)sprintf(tmp, "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (-1 == fd) {
+		free(tmp);
+		return 0;
+	}
+	ok = ((size_t)write(fd, text, len) == len);
+	ok = (close(fd) == 0) && ok;
+	ok = ok && rename(tmp, path) == 0;
+	if (!ok)
+		(void)unlink(tmp);
+	free(tmp);
+	return ok;
+}
+
+/*
+ * One option a line, one with white space or a quote in quotes, with
+ * quotes and backslashes in it escaped
+ */
+static char *render_options(char *lint_argv[], size_t *len)
+{
+	size_t size = 1u;
+	char *text;
+	char *p;
+	int i;
+
+	for (i = 1; lint_argv[i] != NULL; ++i)
+		size += 2u * strlen(lint_argv[i]) + 3u;
+	p = text = (char *)xmalloc(size);
+	for (i = 1; lint_argv[i] != NULL; ++i) {
+		char const *arg = lint_argv[i];
+
+		if (is_source_file(arg))
+			continue;
+		if (NULL == strpbrk(arg, " \t\n\"")) {
+			p += sprintf(p, "%s\n", arg);
+			continue;
+		}
+		*p++ = '"';
+		for (; *arg != '\0'; ++arg) {
+			if ('"' == *arg || '\\' == *arg)
+				*p++ = '\\';
+			*p++ = *arg;
+		}
+		*p++ = '"';
+		*p++ = '\n';
+	}
+	*len = (size_t)(p - text);
+	return text;
+}
+
+/*
+ * Options of a long lint command line are moved to a lint indirect file.
+ * The file is named by its content, so translation units built with the
+ * same options share it and it keeps the lint cache key stable.  It is
+ * kept in the private directory of the user, where no one else can put
+ * a file by that name.
+ */
+char **lint_response_args(char *lint_argv[])
+{
+	struct hash_state state;
+	char hex[HASH_HEX_SIZE];
+	struct arg_vec args = { NULL, 0, 0 };
+	char name[HASH_HEX_SIZE + sizeof(".lnt")];
+	struct stat st;
+	size_t bytes = 0;
+	size_t len;
+	char *text;
+	char *dir;
+	char *path;
+	int i;
+
+	for (i = 0; lint_argv[i] != NULL; ++i)
+		bytes += strlen(lint_argv[i]) + 1u;
+	if (bytes <= LINT_ARG_BYTES)
+		return lint_argv;
+	dir = user_tmp_dir();
+	if (NULL == dir)
+		return lint_argv;
+	text = render_options(lint_argv, &len);
+	hash_init(&state);
+	hash_update(&state, text, len);
+	hash_final_hex(&state, hex);
+	(void)sprintf(name, "%s.lnt", hex);
+	path = xjoin_path(dir, name);
+	free(dir);
+	if ((lstat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+	     st.st_uid != getuid() || (size_t)st.st_size != len) &&
+	    !write_text(path, text, len)) {
+		log_printf(LCI_SEV_WARNING, ("cannot write %s: %s\n", path,
+			   strerror(errno)));
+		free(text);
+		free(path);
+		return lint_argv;
+	}
+	free(text);
+	push_arg(&args, lint_argv[0]);
+	push_arg(&args, path);
+	for (i = 1; lint_argv[i] != NULL; ++i)
+		if (is_source_file(lint_argv[i]))
+			push_arg(&args, lint_argv[i]);
+	return args.vec;
+}
@@ -0,0 +1,32 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_RESPONSE_H_
+#define LCI_INC_RESPONSE_H_
+#else
+#error "LCI_INC_RESPONSE_H_"
+#endif
+
+/*
+ * Response files, @file arguments of the compiler are expanded to see the
+ * real command line, and long lint command lines are passed to lint in an
+ * indirect file
+ */
+
+extern char **expand_response_files(int *argc, char *argv[]);
+extern char **lint_response_args(char *lint_argv[]);
@@ -0,0 +1,994 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "process.h"
+#include "server.h"
+#include "util.h"
+#include "wire.h"
+
+#define MAX_WORKERS 64
+#define MAX_SHIPPED 8
+#define WORKER_CONNECT_MS 500
+#define WORKER_QUERY_MS 200
+
+static volatile sig_atomic_t stop_server = 0;
+
+/*
+ * Lint program of a remote worker, NULL for a local server
+ */
+static char const *worker_lint = NULL;
+
+/*
+ * Units handed to the lint processes of a worker and not done yet,
+ * shared by the worker processes
+ */
+static int *busy_jobs = NULL;
+static int server_jobs = 1;
+
+/*
+ * The accepting process of a worker passes connections of units to the
+ * lint processes through this datagram socket pair, sending on [0]
+ */
+static int handoff[2] = { -1, -1 };
+
+static void on_stop_signal(int sig)
+{
+	(void)sig;
+	stop_server = 1;
+}
+
+char const *lint_server_path(void)
+{
+	char const *path = getenv("LCI_SERVER");
+	return (path != NULL && *path != '\0') ? path : NULL;
+}
+
+static int socket_address(struct sockaddr_un *addr, char const *path)
+{
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		log_printf(LCI_SEV_ERROR, ("socket path too long: %s\n", path));
+		return 0;
+	}
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	(void)strcpy(addr->sun_path, path);
+	return 1;
+}
+
+int lint_server_connect(char const *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (NULL == path || !socket_address(&addr, path))
+		return -1;
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (-1 == sock)
+		return -1;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		log_printf(LCI_SEV_INFORMATIONAL, ("no lint server at %s\n",
+			   path));
+		(void)close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/*
+ * Prints lint output as it arrives, returns the exit code of lint.  -1
+ * when the peer hung up before lint printed anything.
+ */
+static int relay_output(int sock, struct wire_buf *buf)
+{
+	int printed = 0;
+	int code = -1;
+	int type;
+
+	while (code < 0 && wire_recv(sock, &type, buf)) {
+		switch (type) {
+		case WIRE_STDOUT:
+			(void)fwrite(buf->data, 1u, buf->len, stdout);
+			printed = 1;
+			break;
+		case WIRE_STDERR:
+			(void)fwrite(buf->data, 1u, buf->len, stderr);
+			printed = 1;
+			break;
+		case WIRE_EXIT:
+			code = atoi(buf->data);
+			break;
+		default:
+			break;
+		}
+	}
+	if (code < 0 && printed) {
+		fputs(TOOL_NAME ": lint hung up\n", stderr);
+		code = EXIT_FAILURE;
+	}
+	return code;
+}
+
+int lint_server_run(int sock, char *argv[])
+{
+	struct wire_buf buf = { NULL, 0, 0 };
+	char cwd[4096];
+	int code;
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL) {
+		perror(TOOL_NAME ": getcwd");
+		return EXIT_FAILURE;
+	}
+	wire_pack_argv(&buf, cwd, argv);
+	if (!wire_send(sock, WIRE_REQUEST, buf.data, buf.len)) {
+		perror(TOOL_NAME ": lint server");
+		wire_buf_free(&buf);
+		return EXIT_FAILURE;
+	}
+	code = relay_output(sock, &buf);
+	wire_buf_free(&buf);
+	if (code < 0) {
+		fputs(TOOL_NAME ": lint server hung up\n", stderr);
+		code = EXIT_FAILURE;
+	}
+	return code;
+}
+
+char const *lint_workers(void)
+{
+	char const *list = getenv("LCI_WORKERS");
+	return (list != NULL && *list != '\0') ? list : NULL;
+}
+
+/*
+ * Connects to "host:port", giving up after WORKER_CONNECT_MS
+ */
+static int tcp_connect(char const *address)
+{
+	struct addrinfo hints;
+	struct addrinfo *list;
+	struct addrinfo *ai;
+	char const *colon = strrchr(address, ':');
+	char *host;
+	int sock = -1;
+
+	if (NULL == colon)
+		return -1;
+	host = xstrdup(address);
+	host[colon - address] = '\0';
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, colon + 1, &hints, &list) != 0) {
+		log_printf(LCI_SEV_WARNING, ("unknown worker %s\n", address));
+		free(host);
+		return -1;
+	}
+	free(host);
+	for (ai = list; ai != NULL && -1 == sock; ai = ai->ai_next) {
+		struct pollfd pfd;
+		int flags;
+		int err = 0;
+		socklen_t len = sizeof(err);
+
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (-1 == sock)
+			continue;
+		(void)fcntl(sock, F_SETFD, FD_CLOEXEC);
+		flags = fcntl(sock, F_GETFL);
+		(void)fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) != 0) {
+			pfd.fd = sock;
+			pfd.events = POLLOUT;
+			if (errno != EINPROGRESS ||
+			    poll(&pfd, 1, WORKER_CONNECT_MS) != 1 ||
+			    getsockopt(sock, SOL_SOCKET, SO_ERROR, &err,
+				       &len) != 0)
+				err = -1;
+		}
+		if (err != 0) {
+			(void)close(sock);
+			sock = -1;
+			continue;
+		}
+		(void)fcntl(sock, F_SETFL, flags);
+	}
+	freeaddrinfo(list);
+	if (-1 == sock)
+		log_printf(LCI_SEV_INFORMATIONAL, ("no worker at %s\n",
+			   address));
+	return sock;
+}
+
+/*
+ * Load of the worker answering on sock, busy jobs per thousand jobs
+ */
+static int elapsed_ms(struct timespec const *start)
+{
+	struct timespec now;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int)((now.tv_sec - start->tv_sec) * 1000 +
+		     (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+static int worker_load(int sock, struct wire_buf *buf)
+{
+	int busy;
+	int jobs;
+	int type;
+
+	if (!wire_recv(sock, &type, buf) || type != WIRE_LOAD ||
+	    sscanf(buf->data, "%d %d", &busy, &jobs) != 2 || jobs < 1)
+		return -1;
+	return busy * 1000 / jobs;
+}
+
+/*
+ * Asks all workers in list, separated by space or comma, for their load
+ * and connects to the least loaded one.  Equally loaded workers are
+ * taken in an order that depends on the pid, to spread concurrent lci.
+ */
+int lint_worker_connect(char const *list)
+{
+	struct wire_buf buf = { NULL, 0, 0 };
+	struct pollfd pfd[MAX_WORKERS];
+	struct timespec start;
+	char *address[MAX_WORKERS];
+	int load[MAX_WORKERS];
+	char *copy = xstrdup(list);
+	char *tok;
+	int n = 0;
+	int live = 0;
+	int best = -1;
+	int sock = -1;
+	int i;
+
+	for (tok = strtok(copy, " ,"); tok != NULL && n != MAX_WORKERS;
+	     tok = strtok(NULL, " ,")) {
+		address[n] = tok;
+		load[n] = -1;
+		pfd[n].events = POLLIN;
+		pfd[n].fd = tcp_connect(tok);
+		if (pfd[n].fd != -1 &&
+		    !wire_send(pfd[n].fd, WIRE_QUERY, "", 0u)) {
+			(void)close(pfd[n].fd);
+			pfd[n].fd = -1;
+		}
+		live += (pfd[n].fd != -1);
+		++n;
+	}
+	/*
+	 * answered queries are closed, poll skips them
+	 */
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	while (live != 0) {
+		int const left = WORKER_QUERY_MS - elapsed_ms(&start);
+
+		if (left <= 0 || poll(pfd, (nfds_t) n, left) <= 0)
+			break;
+		for (i = 0; i != n; ++i)
+			if (pfd[i].fd != -1 && pfd[i].revents != 0) {
+				load[i] = worker_load(pfd[i].fd, &buf);
+				(void)close(pfd[i].fd);
+				pfd[i].fd = -1;
+				--live;
+			}
+	}
+	for (i = 0; i != n; ++i) {
+		int const k = (int)(((long)getpid() + i) % n);
+
+		if (pfd[k].fd != -1)
+			(void)close(pfd[k].fd);
+		if (load[k] >= 0 && (-1 == best || load[k] < load[best]))
+			best = k;
+	}
+	if (best != -1) {
+		log_printf(LCI_SEV_INFORMATIONAL, ("worker %s, load %d\n",
+			   address[best], load[best]));
+		sock = tcp_connect(address[best]);
+	}
+	wire_buf_free(&buf);
+	free(copy);
+	return sock;
+}
+
+/*
+ * Sends arg and the content read from fd as a WIRE_FILE
+ */
+static int send_file(int sock, char const *arg, int fd, struct wire_buf *buf)
+{
+	size_t const arg_len = strlen(arg) + 1u;
+	ssize_t n;
+
+	buf->len = 0;
+	if (buf->size < arg_len + 4096u) {
+		buf->size = arg_len + 4096u;
+		buf->data = (char *)xrealloc(buf->data, buf->size);
+	}
+	memcpy(buf->data, arg, arg_len);
+	buf->len = arg_len;
+	for (;;) {
+		if (buf->size - buf->len < 4096u) {
+			buf->size *= 2u;
+			buf->data = (char *)xrealloc(buf->data, buf->size);
+		}
+		n = read(fd, &buf->data[buf->len], buf->size - buf->len);
+		if (n > 0)
+			buf->len += (size_t) n;
+		else if (0 == n)
+			break;
+		else if (errno != EINTR)
+			return 0;
+	}
+	return wire_send(sock, WIRE_FILE, buf->data, buf->len);
+}
+
+/*
+ * The source file as preprocessed by the compiler, so the worker needs
+ * neither the headers nor the compiler
+ */
+static int send_preprocessed(int sock, char *compiler_argv[],
+			     char const *source, struct wire_buf *buf)
+{
+	char **const cpp = preprocessor_args(compiler_argv);
+	int pipefd[2];
+	int null_fd;
+	pid_t pid;
+	int ok;
+
+	null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	if (pipe(pipefd) != 0) {
+		(void)close(null_fd);
+		free(cpp);
+		return 0;
+	}
+	(void)fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+	(void)fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+	pid = start_child(cpp, pipefd[1], null_fd);
+	(void)close(pipefd[1]);
+	(void)close(null_fd);
+	free(cpp);
+	ok = (pid > 0) && send_file(sock, source, pipefd[0], buf);
+	(void)close(pipefd[0]);
+	return (pid > 0) && (wait_child(pid) == EXIT_SUCCESS) && ok;
+}
+
+/*
+ * Ships a unit with one source file to the worker on sock.  Lint option
+ * files (.lnt) that are readable here are shipped as they are.  Returns
+ * the exit code of lint, -1 when the unit could not be linted remotely
+ * and nothing has been printed, so it can be linted locally instead.
+ */
+int lint_worker_run(int sock, char *compiler_argv[], char *lint_argv[])
+{
+	struct wire_buf buf = { NULL, 0, 0 };
+	char const *source = NULL;
+	int ok = 1;
+	int code;
+	int i;
+
+	for (i = 1; lint_argv[i] != NULL; ++i)
+		if (is_source_file(lint_argv[i])) {
+			if (source != NULL)
+				return -1;
+			source = lint_argv[i];
+		}
+	if (NULL == source)
+		return -1;
+	ok = send_preprocessed(sock, compiler_argv, source, &buf);
+	for (i = 1; ok && lint_argv[i] != NULL; ++i) {
+		size_t const len = strlen(lint_argv[i]);
+		int fd;
+
+		if (len < 4u || strcmp(&lint_argv[i][len - 4u], ".lnt") != 0)
+			continue;
+		fd = open(lint_argv[i], O_RDONLY | O_CLOEXEC);
+		if (fd != -1) {
+			ok = send_file(sock, lint_argv[i], fd, &buf);
+			(void)close(fd);
+		}
+	}
+	if (ok) {
+		wire_pack_argv(&buf, "", lint_argv);
+		ok = wire_send(sock, WIRE_UNIT, buf.data, buf.len);
+	}
+	code = ok ? relay_output(sock, &buf) : -1;
+	wire_buf_free(&buf);
+	if (code < 0)
+		log_printf(LCI_SEV_WARNING, ("remote lint of %s failed\n",
+			   source));
+	return code;
+}
+
+/*
+ * Forwards one pipe read to the client, returns 0 at end of file
+ */
+static int forward(int from, int sock, int type, int *client_ok)
+{
+	char buf[BUFSIZ];
+	ssize_t n;
+
+	do
+		n = read(from, buf, sizeof(buf));
+	while (-1 == n && EINTR == errno);
+	if (n <= 0)
+		return 0;
+	if (*client_ok && !wire_send(sock, type, buf, (size_t) n))
+		*client_ok = 0;
+	return 1;
+}
+
+static void serve_request(int sock, char *argv[])
+{
+	struct pollfd pfd[3];
+	char code_text[24];
+	int out[2];
+	int err[2];
+	int client_ok = 1;
+	int open_pipes = 2;
+	int status;
+	pid_t cpid;
+
+	if (pipe(out) != 0 || pipe(err) != 0) {
+		perror(TOOL_NAME ": pipe");
+		return;
+	}
+	cpid = start_child(argv, out[1], err[1]);
+	(void)close(out[1]);
+	(void)close(err[1]);
+	pfd[0].fd = out[0];
+	pfd[1].fd = err[0];
+	pfd[2].fd = sock;
+	pfd[0].events = pfd[1].events = pfd[2].events = POLLIN;
+	while (open_pipes != 0) {
+		int i;
+
+		if (poll(pfd, 3, -1) == -1) {
+			if (EINTR == errno)
+				continue;
+			break;
+		}
+		for (i = 0; i != 2; ++i)
+			if (pfd[i].revents != 0 &&
+			    !forward(pfd[i].fd, sock,
+				     (0 == i) ? WIRE_STDOUT : WIRE_STDERR,
+				     &client_ok)) {
+				pfd[i].fd = -1;
+				--open_pipes;
+			}
+		if (pfd[2].revents != 0)
+			client_ok = 0;
+		if (!client_ok && pfd[2].fd != -1) {
+			/*
+			 * nobody is waiting for the result any more
+			 */
+			log_puts(LCI_SEV_INFORMATIONAL, "client gone\n");
+			(void)kill(cpid, SIGTERM);
+			pfd[2].fd = -1;
+		}
+	}
+	(void)close(out[0]);
+	(void)close(err[0]);
+	status = wait_child(cpid);
+	if (WIFEXITED(status))
+		(void)sprintf(code_text, "%d", WEXITSTATUS(status));
+	else if (WIFSIGNALED(status))
+		(void)sprintf(code_text, "%d", WTERMSIG(status));
+	else
+		(void)sprintf(code_text, "%d", EXIT_FAILURE);
+	if (client_ok)
+		(void)wire_send(sock, WIRE_EXIT, code_text, strlen(code_text));
+}
+
+static void serve_local(int sock, struct wire_buf *buf)
+{
+	char **argv;
+	char *cwd;
+	int type;
+
+	if (wire_recv(sock, &type, buf) && WIRE_REQUEST == type &&
+	    (argv = wire_unpack_argv(buf, &cwd)) != NULL) {
+		if (chdir(cwd) == 0)
+			serve_request(sock, argv);
+		else
+			log_printf(LCI_SEV_ERROR, ("chdir %s: %s\n", cwd,
+				   strerror(errno)));
+		free(argv);
+	}
+}
+
+struct shipped_file {
+	char *arg;
+	char *path;
+};
+
+/*
+ * A shipped file keeps its base name, in a directory of its own
+ */
+static char *store_shipped(char const *dir, int index, struct wire_buf *buf)
+{
+	char const *const arg = buf->data;
+	size_t const arg_len = strlen(arg);
+	char const *slash = strrchr(arg, '/');
+	char sub[16];
+	char *subdir;
+	char *path;
+	FILE *f;
+	int ok;
+
+	if (arg_len == buf->len)
+		return NULL;
+	(void)sprintf(sub, "%d", index);
+	subdir = xjoin_path(dir, sub);
+	path = xjoin_path(subdir, (NULL == slash) ? arg : slash + 1);
+	ok = (mkdir(subdir, 0700) == 0);
+	free(subdir);
+	f = ok ? fopen(path, "wb") : NULL;
+	ok = (f != NULL);
+	if (ok) {
+		size_t const len = buf->len - arg_len - 1u;
+		ok = (fwrite(&arg[arg_len + 1u], 1u, len, f) == len);
+		ok = (fclose(f) == 0) && ok;
+	}
+	if (!ok) {
+		log_printf(LCI_SEV_ERROR, ("cannot store %s\n", path));
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
+static void remove_shipped(char const *dir, struct shipped_file *files,
+			   int count)
+{
+	int i;
+
+	for (i = 0; i != count; ++i) {
+		char *const slash = strrchr(files[i].path, '/');
+
+		(void)unlink(files[i].path);
+		*slash = '\0';
+		(void)rmdir(files[i].path);
+		free(files[i].path);
+		free(files[i].arg);
+	}
+	(void)rmdir(dir);
+}
+
+static void send_load(int sock)
+{
+	char load[48];
+
+	(void)sprintf(load, "%d %d", *busy_jobs, server_jobs);
+	(void)wire_send(sock, WIRE_LOAD, load, strlen(load));
+}
+
+/*
+ * A remote unit, its files are stored in a temporary directory and the
+ * arguments naming them are changed to the stored files.  lint is the
+ * one of the worker, whatever the client asked for.
+ */
+static void serve_remote(int sock, struct wire_buf *buf)
+{
+	struct shipped_file files[MAX_SHIPPED];
+	char const *tmpdir = getenv("TMPDIR");
+	char *dir = NULL;
+	int count = 0;
+	int type;
+
+	if (NULL == tmpdir || '\0' == *tmpdir)
+		tmpdir = "/tmp";
+	while (wire_recv(sock, &type, buf)) {
+		char **argv;
+		char *cwd;
+		int i;
+		int j;
+
+		if (WIRE_QUERY == type) {
+			send_load(sock);
+			break;
+		}
+		if (WIRE_FILE == type && count != MAX_SHIPPED) {
+			if (NULL == dir) {
+				dir = xjoin_path(tmpdir, "lci-worker.XXXXXX");
+				if (NULL == mkdtemp(dir)) {
+					perror(TOOL_NAME ": mkdtemp");
+					break;
+				}
+			}
+			files[count].path = store_shipped(dir, count, buf);
+			if (NULL == files[count].path)
+				break;
+			files[count++].arg = xstrdup(buf->data);
+			continue;
+		}
+		if (type != WIRE_UNIT ||
+		    (argv = wire_unpack_argv(buf, &cwd)) == NULL)
+			break;
+		argv[0] = (char *)worker_lint;
+		for (i = 1; argv[i] != NULL; ++i)
+			for (j = 0; j != count; ++j)
+				if (strcmp(argv[i], files[j].arg) == 0)
+					argv[i] = files[j].path;
+		if (chdir((NULL == dir) ? tmpdir : dir) == 0)
+			serve_request(sock, argv);
+		(void)chdir("/");
+		free(argv);
+		break;
+	}
+	if (dir != NULL)
+		remove_shipped(dir, files, count);
+	free(dir);
+}
+
+static int accept_connection(int listener)
+{
+	int sock;
+
+	do
+		sock = accept(listener, NULL, NULL);
+	while (-1 == sock && (EINTR == errno || ECONNABORTED == errno));
+	if (-1 == sock) {
+		perror(TOOL_NAME ": accept");
+		_exit(EXIT_FAILURE);
+	}
+	(void)fcntl(sock, F_SETFD, FD_CLOEXEC);
+	return sock;
+}
+
+static int send_connection(int sock)
+{
+	char cmsg_buf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char byte = 'U';
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cmsg_buf, 0, sizeof(cmsg_buf));
+	iov.iov_base = &byte;
+	iov.iov_len = 1u;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buf;
+	msg.msg_controllen = sizeof(cmsg_buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &sock, sizeof(int));
+	do
+		n = sendmsg(handoff[0], &msg, 0);
+	while (-1 == n && EINTR == errno);
+	return 1 == n;
+}
+
+/*
+ * Waits for the accepting process to pass a connection
+ */
+static int receive_connection(void)
+{
+	char cmsg_buf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char byte;
+	ssize_t n;
+	int sock;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &byte;
+	iov.iov_len = 1u;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buf;
+	msg.msg_controllen = sizeof(cmsg_buf);
+	do
+		n = recvmsg(handoff[1], &msg, 0);
+	while (-1 == n && EINTR == errno);
+	cmsg = (n > 0) ? CMSG_FIRSTHDR(&msg) : NULL;
+	if (NULL == cmsg || cmsg->cmsg_type != SCM_RIGHTS) {
+		perror(TOOL_NAME ": recvmsg");
+		_exit(EXIT_FAILURE);
+	}
+	memcpy(&sock, CMSG_DATA(cmsg), sizeof(int));
+	(void)fcntl(sock, F_SETFD, FD_CLOEXEC);
+	return sock;
+}
+
+static void worker_loop(int listener)
+{
+	struct wire_buf buf = { NULL, 0, 0 };
+
+	for (;;) {
+		int sock;
+
+		if (NULL == worker_lint) {
+			sock = accept_connection(listener);
+			serve_local(sock, &buf);
+		} else {
+			sock = receive_connection();
+			serve_remote(sock, &buf);
+			(void)__sync_fetch_and_sub(busy_jobs, 1);
+		}
+		(void)close(sock);
+		log_flush();
+	}
+}
+
+/*
+ * The type of the first message on sock without reading it, 0 when none
+ * came in time, -1 when sock was closed without one
+ */
+static int first_type(int sock)
+{
+	struct pollfd pfd;
+	unsigned char type;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, WORKER_QUERY_MS) != 1)
+		return 0;
+	return (recv(sock, &type, 1u, MSG_PEEK) == 1) ? type : -1;
+}
+
+/*
+ * The accepting process of a worker answers load queries itself, also
+ * while every lint process is busy, and queues units for the lint
+ * processes
+ */
+static void accept_loop(int listener)
+{
+	struct wire_buf buf = { NULL, 0, 0 };
+
+	for (;;) {
+		int const sock = accept_connection(listener);
+		int const type = first_type(sock);
+		int query;
+
+		if (WIRE_QUERY == type) {
+			if (wire_recv(sock, &query, &buf))
+				send_load(sock);
+		} else if (type != -1) {
+			(void)__sync_fetch_and_add(busy_jobs, 1);
+			if (!send_connection(sock)) {
+				perror(TOOL_NAME ": sendmsg");
+				(void)__sync_fetch_and_sub(busy_jobs, 1);
+			}
+		}
+		(void)close(sock);
+	}
+}
+
+/*
+ * Process index jobs of a remote worker accepts, the others lint
+ */
+static pid_t start_worker(int listener, int index)
+{
+	pid_t const pid = fork();
+
+	if (-1 == pid) {
+		perror(TOOL_NAME ": fork");
+		return -1;
+	}
+	if (0 == pid) {
+		log_forked();
+		(void)signal(SIGPIPE, SIG_IGN);
+		(void)signal(SIGTERM, SIG_DFL);
+		(void)signal(SIGINT, SIG_DFL);
+		if (index == server_jobs)
+			accept_loop(listener);
+		worker_loop(listener);
+	}
+	return pid;
+}
+
+static int listen_on(char const *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (!socket_address(&addr, path))
+		return -1;
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (-1 == sock) {
+		perror(TOOL_NAME ": socket");
+		return -1;
+	}
+	(void)fcntl(sock, F_SETFD, FD_CLOEXEC);
+	/*
+	 * a stale socket from a server that died
+	 */
+	(void)unlink(path);
+	(void)umask(077);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(sock, 128) != 0) {
+		perror(TOOL_NAME ": bind");
+		(void)close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/*
+ * "port" or "host:port", 127.0.0.1 when the host is left out.
+ * lint runs what any client that can connect sends, so other hosts are
+ * only let in by naming the address to listen on.
+ */
+static int listen_tcp(char const *address)
+{
+	struct addrinfo hints;
+	struct addrinfo *list;
+	struct addrinfo *ai;
+	char const *colon = strrchr(address, ':');
+	char *host;
+	int sock = -1;
+	int err;
+
+	if (colon != NULL) {
+		host = xstrdup(address);
+		host[colon - address] = '\0';
+		address = colon + 1;
+	} else {
+		host = xstrdup("127.0.0.1");
+	}
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo(host, address, &hints, &list);
+	free(host);
+	if (err != 0) {
+		fprintf(stderr, TOOL_NAME ": %s: %s\n", address,
+			gai_strerror(err));
+		return -1;
+	}
+	for (ai = list; ai != NULL && -1 == sock; ai = ai->ai_next) {
+		int const on = 1;
+
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (-1 == sock)
+			continue;
+		(void)fcntl(sock, F_SETFD, FD_CLOEXEC);
+		(void)setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on,
+				 sizeof(on));
+		if (bind(sock, ai->ai_addr, ai->ai_addrlen) != 0 ||
+		    listen(sock, 128) != 0) {
+			(void)close(sock);
+			sock = -1;
+		}
+	}
+	freeaddrinfo(list);
+	if (-1 == sock)
+		perror(TOOL_NAME ": bind");
+	return sock;
+}
+
+/*
+ * Prefork server, jobs workers accept requests from the shared socket,
+ * so at most jobs lint processes run at a time.  A remote worker has one
+ * more process that accepts and passes units on.
+ */
+static void serve(int listener, int jobs, char const *name)
+{
+	struct sigaction sa;
+	pid_t *workers;
+	int procs;
+	int i;
+
+	server_jobs = jobs;
+	procs = jobs + (worker_lint != NULL);
+	sa.sa_handler = on_stop_signal;
+	sa.sa_flags = 0;
+	(void)sigemptyset(&sa.sa_mask);
+	(void)sigaction(SIGTERM, &sa, NULL);
+	(void)sigaction(SIGINT, &sa, NULL);
+	workers = (pid_t *) xmalloc(sizeof(pid_t) * (size_t) procs);
+	for (i = 0; i != procs; ++i)
+		workers[i] = start_worker(listener, i);
+	log_printf(LCI_SEV_NOTICE, ("serving %d jobs on %s\n", jobs, name));
+	while (!stop_server) {
+		int status;
+		pid_t pid;
+
+		/*
+		 * a long running server writes its log as it goes
+		 */
+		log_flush();
+		pid = waitpid(-1, &status, 0);
+
+		if (-1 == pid) {
+			if (EINTR == errno)
+				continue;
+			break;
+		}
+		for (i = 0; i != procs; ++i)
+			if (workers[i] == pid && !stop_server) {
+				log_printf(LCI_SEV_WARNING,(
+					   "worker %ld died\n", (long)pid));
+				workers[i] = start_worker(listener, i);
+			}
+	}
+	for (i = 0; i != procs; ++i)
+		if (workers[i] > 0)
+			(void)kill(workers[i], SIGTERM);
+	while (waitpid(-1, NULL, 0) > 0 || EINTR == errno) ;
+	(void)close(listener);
+	free(workers);
+}
+
+int lint_server_main(char const *path, int jobs)
+{
+	int const listener = listen_on(path);
+
+	if (-1 == listener)
+		return EXIT_FAILURE;
+	serve(listener, (jobs < 1) ? 1 : jobs, path);
+	(void)unlink(path);
+	return EXIT_SUCCESS;
+}
+
+int lint_worker_main(char const *address, int jobs, char const *lint)
+{
+	int listener;
+
+	busy_jobs = (int *)mmap(NULL, sizeof(*busy_jobs),
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == (void *)busy_jobs) {
+		perror(TOOL_NAME ": mmap");
+		return EXIT_FAILURE;
+	}
+	*busy_jobs = 0;
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, handoff) != 0) {
+		perror(TOOL_NAME ": socketpair");
+		return EXIT_FAILURE;
+	}
+	(void)fcntl(handoff[0], F_SETFD, FD_CLOEXEC);
+	(void)fcntl(handoff[1], F_SETFD, FD_CLOEXEC);
+	listener = listen_tcp(address);
+	if (-1 == listener)
+		return EXIT_FAILURE;
+	worker_lint = lint;
+	serve(listener, (jobs < 1) ? 1 : jobs, address);
+	return EXIT_SUCCESS;
+}
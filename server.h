@@ -0,0 +1,50 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_SERVER_H_
+#define LCI_INC_SERVER_H_
+#else
+#error "LCI_INC_SERVER_H_"
+#endif
+
+/*
+ * Lint server on the Unix domain socket named by LCI_SERVER.  lci sends
+ * the lint argv and working directory, the server runs lint in one of
+ * its workers and streams output and exit code back.  Lint has no mode
+ * that stays resident, so a worker still starts lint for every request.
+ * What the server gives is one limit on the lint runs of all builds on
+ * the machine, LCI_SERVER_JOBS, not a warm lint.
+ */
+
+extern char const *lint_server_path(void);
+extern int lint_server_connect(char const *path);
+extern int lint_server_run(int sock, char *argv[]);
+extern int lint_server_main(char const *path, int jobs);
+
+/*
+ * Remote lint workers, lci-worker listening on the TCP addresses listed
+ * in LCI_WORKERS.  lci ships the preprocessed source file and the lint
+ * argv to the least loaded worker, which runs its own lint program.  A
+ * worker runs what it is sent, it listens on the loopback address unless
+ * the address to listen on is given, which should be on a trusted network.
+ */
+
+extern char const *lint_workers(void);
+extern int lint_worker_connect(char const *list);
+extern int lint_worker_run(int sock, char *compiler_argv[], char *lint_argv[]);
+extern int lint_worker_main(char const *address, int jobs, char const *lint);
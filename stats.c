@@ -0,0 +1,345 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * lci-stats, what lint costs a build, from the LCI_TRACE records.  The
+ * records are read in one pass, memory grows with the number of source
+ * directories and the lci runs in flight, not with the number of records.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "trace.h"
+#include "util.h"
+
+#define STATS_NAME "lci-stats"
+#define DEFAULT_TOP 10
+
+/*
+ * lci runs whose own record is still to come, a full table drops the
+ * oldest guess
+ */
+#define MAX_IN_FLIGHT 4096
+
+struct totals {
+	double wall;
+	double cpu;
+	unsigned long count;
+};
+
+struct slow_unit {
+	unsigned long wall_us;
+	char unit[1024];
+};
+
+struct dir_cost {
+	char *dir;
+	double lint_cpu;
+	double compile_cpu;
+};
+
+struct in_flight {
+	long lci_pid;
+	unsigned long compile_wall_us;
+};
+
+struct stats {
+	struct totals compile;
+	struct totals preprocess;
+	struct totals lint;
+	struct totals lci;
+	double lint_added;
+	struct slow_unit *slowest;
+	int top;
+	struct dir_cost *dirs;
+	size_t dir_count;
+	size_t dir_capacity;
+	struct in_flight running[MAX_IN_FLIGHT];
+};
+
+static double seconds(unsigned long us)
+{
+	return (double)us / 1e6;
+}
+
+static unsigned long string_hash(char const *str)
+{
+	unsigned long h = 2166136261UL;
+
+	for (; *str != '\0'; ++str)
+		h = ((h ^ (unsigned char)*str) * 16777619UL) & 0xFFFFFFFFUL;
+	return h;
+}
+
+static struct dir_cost *insert_dir(struct dir_cost *dirs, size_t capacity,
+				   char *dir)
+{
+	size_t i = string_hash(dir) & (capacity - 1u);
+
+	while (dirs[i].dir != NULL && strcmp(dirs[i].dir, dir) != 0)
+		i = (i + 1u) & (capacity - 1u);
+	if (NULL == dirs[i].dir) {
+		dirs[i].dir = dir;
+		dirs[i].lint_cpu = 0.0;
+		dirs[i].compile_cpu = 0.0;
+	}
+	return &dirs[i];
+}
+
+static void grow_dirs(struct stats *st)
+{
+	struct dir_cost *old = st->dirs;
+	size_t const old_capacity = st->dir_capacity;
+	size_t i;
+
+	st->dir_capacity = (0 == old_capacity) ? 256u : 2u * old_capacity;
+	st->dirs = (struct dir_cost *)xmalloc(st->dir_capacity *
+					      sizeof(*st->dirs));
+	for (i = 0; i != st->dir_capacity; ++i)
+		st->dirs[i].dir = NULL;
+	for (i = 0; i != old_capacity; ++i)
+		if (old[i].dir != NULL)
+			*insert_dir(st->dirs, st->dir_capacity, old[i].dir) =
+			    old[i];
+	free(old);
+}
+
+static struct dir_cost *find_dir(struct stats *st, char const *unit)
+{
+	char const *slash = strrchr(unit, '/');
+	size_t const len = (NULL == slash) ? 0u : (size_t)(slash - unit);
+	struct dir_cost *d;
+	char *dir;
+
+	dir = (char *)xmalloc(len + 2u);
+	if (0u == len) {
+		(void)strcpy(dir, (NULL == slash) ? "." : "/");
+	} else {
+		memcpy(dir, unit, len);
+		dir[len] = '\0';
+	}
+	if (2u * (st->dir_count + 1u) > st->dir_capacity)
+		grow_dirs(st);
+	d = insert_dir(st->dirs, st->dir_capacity, dir);
+	if (d->dir == dir)
+		++st->dir_count;
+	else
+		free(dir);
+	return d;
+}
+
+static struct in_flight *find_run(struct stats *st, long lci_pid)
+{
+	struct in_flight *run = &st->running[(unsigned long)lci_pid %
+					     MAX_IN_FLIGHT];
+
+	if (run->lci_pid != lci_pid) {
+		run->lci_pid = lci_pid;
+		run->compile_wall_us = 0;
+	}
+	return run;
+}
+
+static void add_total(struct totals *t, struct trace_record const *rec)
+{
+	t->wall += seconds(rec->wall_us);
+	t->cpu += seconds(rec->user_us + rec->sys_us);
+	++t->count;
+}
+
+static void add_slow(struct stats *st, struct trace_record const *rec)
+{
+	int min = 0;
+	int i;
+
+	for (i = 1; i < st->top; ++i)
+		if (st->slowest[i].wall_us < st->slowest[min].wall_us)
+			min = i;
+	if (st->top > 0 && rec->wall_us > st->slowest[min].wall_us) {
+		st->slowest[min].wall_us = rec->wall_us;
+		(void)strcpy(st->slowest[min].unit, rec->unit);
+	}
+}
+
+/*
+ * The wall time lint adds to a compile step is the time lci ran beyond
+ * its compiler, all of lci when it only linted
+ */
+static void add_record(struct stats *st, struct trace_record const *rec)
+{
+	double const cpu = seconds(rec->user_us + rec->sys_us);
+	struct in_flight *run;
+
+	switch (rec->role) {
+	case TRACE_COMPILER:
+		add_total(&st->compile, rec);
+		find_dir(st, rec->unit)->compile_cpu += cpu;
+		find_run(st, rec->lci_pid)->compile_wall_us += rec->wall_us;
+		break;
+	case TRACE_PREPROCESSOR:
+		add_total(&st->preprocess, rec);
+		break;
+	case TRACE_LINT:
+		add_total(&st->lint, rec);
+		find_dir(st, rec->unit)->lint_cpu += cpu;
+		add_slow(st, rec);
+		break;
+	case TRACE_LCI:
+		add_total(&st->lci, rec);
+		run = find_run(st, rec->lci_pid);
+		if (rec->wall_us > run->compile_wall_us)
+			st->lint_added +=
+			    seconds(rec->wall_us - run->compile_wall_us);
+		run->lci_pid = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+static int read_records(struct stats *st, FILE * in, char const *name)
+{
+	struct trace_record rec;
+	char line[1536];
+
+	while (fgets(line, sizeof(line), in) != NULL)
+		if (trace_parse(line, &rec))
+			add_record(st, &rec);
+	if (ferror(in)) {
+		fprintf(stderr, STATS_NAME ": %s: %s\n", name, strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+static int compare_slow(void const *lhs, void const *rhs)
+{
+	unsigned long const l = ((struct slow_unit const *)lhs)->wall_us;
+	unsigned long const r = ((struct slow_unit const *)rhs)->wall_us;
+	return (l < r) - (l > r);
+}
+
+static int compare_dir(void const *lhs, void const *rhs)
+{
+	double const l = ((struct dir_cost const *)lhs)->lint_cpu;
+	double const r = ((struct dir_cost const *)rhs)->lint_cpu;
+	return (l < r) - (l > r);
+}
+
+static void print_totals(char const *what, struct totals const *t)
+{
+	printf("  %-10s %9lu %12.3f %12.3f\n", what, t->count, t->wall, t->cpu);
+}
+
+static void report(struct stats *st)
+{
+	size_t n = 0;
+	size_t i;
+	int j;
+
+	printf("totals\n  %-10s %9s %12s %12s\n", "", "runs", "wall s",
+	       "cpu s");
+	print_totals("compile", &st->compile);
+	print_totals("preprocess", &st->preprocess);
+	print_totals("lint", &st->lint);
+	print_totals(TOOL_NAME, &st->lci);
+	printf("  lint added %.3f s wall to compile steps\n", st->lint_added);
+
+	qsort(st->slowest, (size_t)st->top, sizeof(*st->slowest),
+	      compare_slow);
+	printf("\nslowest lint runs\n  %12s  %s\n", "wall s", "unit");
+	for (j = 0; j != st->top && st->slowest[j].wall_us != 0; ++j)
+		printf("  %12.3f  %s\n", seconds(st->slowest[j].wall_us),
+		       st->slowest[j].unit);
+
+	for (i = 0; i != st->dir_capacity; ++i)
+		if (st->dirs[i].dir != NULL)
+			st->dirs[n++] = st->dirs[i];
+	qsort(st->dirs, n, sizeof(*st->dirs), compare_dir);
+	printf("\nlint to compile cpu by directory\n  %8s %12s %12s  %s\n",
+	       "ratio", "lint s", "compile s", "directory");
+	for (i = 0; i != n && i != (size_t)st->top; ++i) {
+		struct dir_cost const *d = &st->dirs[i];
+
+		if (d->compile_cpu > 0.0)
+			printf("  %8.2f", d->lint_cpu / d->compile_cpu);
+		else
+			printf("  %8s", "-");
+		printf(" %12.3f %12.3f  %s\n", d->lint_cpu, d->compile_cpu,
+		       d->dir);
+	}
+}
+
+static void print_usage(FILE * stream)
+{
+	fputs("usage: " STATS_NAME " [-n count] [trace file...]\n"
+	      "    reads LCI_TRACE records, standard input without files\n",
+	      stream);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct stats st;
+	int first = 1;
+	int ok = 1;
+	int i;
+
+	st.top = DEFAULT_TOP;
+	if (first + 1 < argc && strcmp(argv[first], "-n") == 0) {
+		st.top = atoi(argv[first + 1]);
+		first += 2;
+	}
+	if (first < argc && '-' == argv[first][0] && argv[first][1] != '\0') {
+		print_usage(stderr);
+		return EXIT_FAILURE;
+	}
+	if (st.top < 0)
+		st.top = 0;
+	st.slowest = (struct slow_unit *)xmalloc(sizeof(*st.slowest) *
+						 (size_t)(st.top + 1));
+	for (i = 0; i <= st.top; ++i)
+		st.slowest[i].wall_us = 0;
+	grow_dirs(&st);
+	i = first;
+	if (i >= argc)
+		ok = read_records(&st, stdin, "stdin");
+	for (; i < argc; ++i) {
+		FILE *in = strcmp(argv[i], "-") == 0 ? stdin :
+		    fopen(argv[i], "r");
+
+		if (NULL == in) {
+			fprintf(stderr, STATS_NAME ": %s: %s\n", argv[i],
+				strerror(errno));
+			ok = 0;
+			continue;
+		}
+		ok = read_records(&st, in, argv[i]) && ok;
+		if (in != stdin)
+			(void)fclose(in);
+	}
+	report(&st);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
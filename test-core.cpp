@@ -17,13 +17,47 @@
  */
 
 extern "C" {
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utime.h>
+#include "analyzer.h"
+#include "args.h"
+#include "async.h"
+#include "cache.h"
 #include "core.h"
+#include "dedup.h"
+#include "hash.h"
+#include "jobserver.h"
+#include "manifest.h"
+#include "output.h"
+#include "priority.h"
+#include "response.h"
+#include "server.h"
+#include "trace.h"
 #include "util.h"
+#include "wire.h"
 }
 
 #include <gmock/gmock.h>
+#include <sstream>
+#include <string>
 
 #define ARGV_COUNT(x) (((int)sizeof(x) / (int)sizeof(*x)) - 1)
 
@@ -443,6 +477,84 @@ TEST(LciOptions, RunLintOptionShort)
 	run_lint = old_run_lint;
 }
 
+TEST(LciOptions, ParallelOptionLong)
+{
+	char const* argv[] = { RandomString[1], "--parallel", NULL };
+	char const* const expected_argv[] = { RandomString[1], NULL };
+	int const old_parallel_lint = parallel_lint;
+	parallel_lint = false;
+
+	TestLciOptions(argv, expected_argv);
+	EXPECT_TRUE(parallel_lint);
+
+	parallel_lint = old_parallel_lint;
+}
+
+TEST(LciOptions, ParallelOptionJustLongEnough)
+{
+	char const* argv[] = { RandomString[1], "--p", NULL };
+	char const* const expected_argv[] = { RandomString[1], NULL };
+	int const old_parallel_lint = parallel_lint;
+	parallel_lint = false;
+
+	TestLciOptions(argv, expected_argv);
+	EXPECT_TRUE(parallel_lint);
+
+	parallel_lint = old_parallel_lint;
+}
+
+TEST(LciOptions, ParallelOptionShort)
+{
+	char const* argv[] = { RandomString[1], "-p", NULL };
+	char const* const expected_argv[] = { RandomString[1], NULL };
+	int const old_parallel_lint = parallel_lint;
+	parallel_lint = false;
+
+	TestLciOptions(argv, expected_argv);
+	EXPECT_TRUE(parallel_lint);
+
+	parallel_lint = old_parallel_lint;
+}
+
+TEST(LciOptions, QueueLintOptionLong)
+{
+	char const* argv[] = { RandomString[1], "--queue-lint", NULL };
+	char const* const expected_argv[] = { RandomString[1], NULL };
+	int const old_queue_lint = queue_lint;
+	queue_lint = false;
+
+	TestLciOptions(argv, expected_argv);
+	EXPECT_TRUE(queue_lint);
+
+	queue_lint = old_queue_lint;
+}
+
+TEST(LciOptions, QueueLintOptionJustLongEnough)
+{
+	char const* argv[] = { RandomString[1], "--q", NULL };
+	char const* const expected_argv[] = { RandomString[1], NULL };
+	int const old_queue_lint = queue_lint;
+	queue_lint = false;
+
+	TestLciOptions(argv, expected_argv);
+	EXPECT_TRUE(queue_lint);
+
+	queue_lint = old_queue_lint;
+}
+
+TEST(LciOptions, QueueLintOptionShort)
+{
+	char const* argv[] = { RandomString[1], "-q", NULL };
+	char const* const expected_argv[] = { RandomString[1], NULL };
+	int const old_queue_lint = queue_lint;
+	queue_lint = false;
+
+	TestLciOptions(argv, expected_argv);
+	EXPECT_TRUE(queue_lint);
+
+	queue_lint = old_queue_lint;
+}
+
 TEST(LciOptions, VerboseOptionLong)
 {
 	char const* argv[] = { RandomString[1], "--verbose", NULL };
@@ -544,6 +656,1722 @@ TEST(LciOptionsDeathTest, VersionOptionJustLongEnough)
 	stream_format_output = fprintf;
 }
 
+static std::string md5_hex(char const *data, size_t split)
+{
+	struct hash_state state;
+	char hex[HASH_HEX_SIZE];
+
+	hash_init(&state);
+	hash_update(&state, data, split);
+	hash_update(&state, data + split, strlen(data) - split);
+	hash_final_hex(&state, hex);
+	return hex;
+}
+
+TEST(Hash, KnownDigests)
+{
+	EXPECT_THAT(md5_hex("", 0), StrEq("d41d8cd98f00b204e9800998ecf8427e"));
+	EXPECT_THAT(md5_hex("abc", 0), StrEq("900150983cd24fb0d6963f7d28e17f72"));
+	EXPECT_THAT(md5_hex("12345678901234567890123456789012345678901234567890"
+			"123456789012345678901234567890", 0),
+			StrEq("57edf4a22be3c955ac49da2e2107b67a"));
+}
+
+TEST(Hash, SplitUpdatesGiveSameDigest)
+{
+	char const text[] = "The quick brown fox jumps over the lazy dog, "
+			"then the lazy dog jumps over the quick brown fox";
+
+	for (size_t i = 0; i != sizeof(text) - 1; ++i)
+		EXPECT_THAT(md5_hex(text, i), StrEq(md5_hex(text, 0)));
+}
+
+TEST(ParseSize, Suffixes)
+{
+	EXPECT_THAT(parse_size("512"), Eq(512UL));
+	EXPECT_THAT(parse_size("2k"), Eq(2048UL));
+	EXPECT_THAT(parse_size("3M"), Eq(3UL * 1024 * 1024));
+	EXPECT_THAT(parse_size("1G"), Eq(1024UL * 1024 * 1024));
+}
+
+TEST(ParseSize, Garbage)
+{
+	EXPECT_THAT(parse_size(""), Eq(0UL));
+	EXPECT_THAT(parse_size("M"), Eq(0UL));
+	EXPECT_THAT(parse_size("10X"), Eq(0UL));
+	EXPECT_THAT(parse_size("10MB"), Eq(0UL));
+}
+
+static std::string line_marker_file(char const *line)
+{
+	char *path = parse_line_marker(line);
+	std::string const ret = (path != NULL) ? path : "(null)";
+	free(path);
+	return ret;
+}
+
+TEST(ParseLineMarker, Markers)
+{
+	EXPECT_THAT(line_marker_file("# 1 \"t.c\""), StrEq("t.c"));
+	EXPECT_THAT(line_marker_file("# 12 \"/usr/include/stdio.h\" 1 3 4"),
+			StrEq("/usr/include/stdio.h"));
+	EXPECT_THAT(line_marker_file("#line 7 \"a b.h\""), StrEq("a b.h"));
+	EXPECT_THAT(line_marker_file("# 3 \"C:\\\\x\\\"y.h\""),
+			StrEq("C:\\x\"y.h"));
+}
+
+TEST(ParseLineMarker, NotMarkers)
+{
+	EXPECT_THAT(line_marker_file("# 1 \"<built-in>\""), StrEq("(null)"));
+	EXPECT_THAT(line_marker_file("#pragma once"), StrEq("(null)"));
+	EXPECT_THAT(line_marker_file("# 1 \"\""), StrEq("(null)"));
+	EXPECT_THAT(line_marker_file("# 1 \"open"), StrEq("(null)"));
+	EXPECT_THAT(line_marker_file("int x;"), StrEq("(null)"));
+}
+
+TEST(JobserverParse, NoJobserver)
+{
+	struct jobserver js;
+
+	EXPECT_FALSE(jobserver_parse(&js, NULL));
+	EXPECT_FALSE(jobserver_parse(&js, ""));
+	EXPECT_FALSE(jobserver_parse(&js, "-j4 -k"));
+	EXPECT_FALSE(jobserver_parse(&js, " --jobserver-auth=x,y"));
+	EXPECT_THAT(js.read_fd, Eq(-1));
+	EXPECT_THAT(js.fifo, IsNull());
+}
+
+TEST(JobserverParse, Pipe)
+{
+	struct jobserver js;
+
+	ASSERT_TRUE(jobserver_parse(&js, " -j32 --jobserver-auth=3,4"));
+	EXPECT_THAT(js.read_fd, Eq(3));
+	EXPECT_THAT(js.write_fd, Eq(4));
+	EXPECT_THAT(js.fifo, IsNull());
+}
+
+TEST(JobserverParse, OldMakePipe)
+{
+	struct jobserver js;
+
+	ASSERT_TRUE(jobserver_parse(&js, "k --jobserver-fds=5,6 -j"));
+	EXPECT_THAT(js.read_fd, Eq(5));
+	EXPECT_THAT(js.write_fd, Eq(6));
+}
+
+TEST(JobserverParse, Fifo)
+{
+	struct jobserver js;
+
+	ASSERT_TRUE(jobserver_parse(&js,
+			"-j8 --jobserver-auth=fifo:/tmp/GMfifo42 -- X=1"));
+	EXPECT_THAT(js.fifo, StrEq("/tmp/GMfifo42"));
+	free(js.fifo);
+}
+
+TEST(JobserverParse, LastOptionCounts)
+{
+	struct jobserver js;
+
+	ASSERT_TRUE(jobserver_parse(&js,
+			"--jobserver-auth=3,4 --jobserver-auth=7,8"));
+	EXPECT_THAT(js.read_fd, Eq(7));
+	EXPECT_THAT(js.write_fd, Eq(8));
+}
+
+/*
+ * The pipe of make stays blocking for the other clients, lci reads its
+ * own non-blocking open file description
+ */
+TEST(JobserverAcquire, PipeReadIsNonBlocking)
+{
+	struct jobserver js;
+	char makeflags[64];
+	char token = 0;
+	int fds[2];
+
+	ASSERT_THAT(pipe(fds), Eq(0));
+	(void)sprintf(makeflags, "-j2 --jobserver-auth=%d,%d", fds[0], fds[1]);
+	(void)setenv("MAKEFLAGS", makeflags, 1);
+	jobserver_open(&js);
+	(void)unsetenv("MAKEFLAGS");
+	ASSERT_TRUE(js.own_read_fd);
+	EXPECT_THAT(js.read_fd, Ne(fds[0]));
+	EXPECT_TRUE(fcntl(js.read_fd, F_GETFL) & O_NONBLOCK);
+	EXPECT_FALSE(fcntl(fds[0], F_GETFL) & O_NONBLOCK);
+	EXPECT_FALSE(jobserver_try_acquire(&js));
+	ASSERT_THAT(write(fds[1], "+", 1u), Eq(1));
+	EXPECT_TRUE(jobserver_try_acquire(&js));
+	jobserver_close(&js);
+	EXPECT_THAT(read(fds[0], &token, 1u), Eq(1));
+	EXPECT_THAT(token, Eq('+'));
+	(void)close(fds[0]);
+	(void)close(fds[1]);
+}
+
+TEST(IsCompilerName, List)
+{
+	EXPECT_TRUE(is_compiler_name("gcc", "cc gcc"));
+	EXPECT_TRUE(is_compiler_name("/usr/bin/cc", "cc gcc"));
+	EXPECT_TRUE(is_compiler_name("g++", "gcc:g++"));
+	EXPECT_FALSE(is_compiler_name("/usr/bin/gcc-ar", "cc gcc"));
+	EXPECT_FALSE(is_compiler_name("c", "cc gcc"));
+	EXPECT_FALSE(is_compiler_name("gcc", ""));
+}
+
+static int compiles(char const *line)
+{
+	char buf[256];
+	char *argv[32];
+	int argc = 0;
+	char *tok;
+
+	(void)strcpy(buf, line);
+	for (tok = strtok(buf, " "); tok != NULL; tok = strtok(NULL, " "))
+		argv[argc++] = tok;
+	argv[argc] = NULL;
+	return will_compile_and_or_link(argc, argv);
+}
+
+TEST(WillCompileAndOrLink, Compiles)
+{
+	EXPECT_TRUE(compiles("lci gcc -c a.c"));
+	EXPECT_TRUE(compiles("lci gcc -c -o a.o a.cpp"));
+	EXPECT_TRUE(compiles("lci gcc -MD -MF a.d -DX=1 -I inc a.c"));
+	EXPECT_TRUE(compiles("lci cc -v a.c b.o -o prog"));
+	EXPECT_TRUE(compiles("lci gcc -x c -c input"));
+	EXPECT_TRUE(compiles("lci gcc -xc++ -c -"));
+}
+
+TEST(WillCompileAndOrLink, DoesNotCompile)
+{
+	EXPECT_FALSE(compiles("lci"));
+	EXPECT_FALSE(compiles("lci gcc"));
+	EXPECT_FALSE(compiles("lci gcc -E a.c"));
+	EXPECT_FALSE(compiles("lci gcc -M a.c"));
+	EXPECT_FALSE(compiles("lci gcc -MM -MT a.o a.c"));
+	EXPECT_FALSE(compiles("lci gcc -S a.c"));
+	EXPECT_FALSE(compiles("lci gcc --version"));
+	EXPECT_FALSE(compiles("lci gcc -v"));
+	EXPECT_FALSE(compiles("lci gcc -print-file-name=libc.a"));
+	EXPECT_FALSE(compiles("lci gcc a.o b.o -o prog -lm"));
+	EXPECT_FALSE(compiles("lci gcc -o x.c a.o"));
+	EXPECT_FALSE(compiles("lci gcc -x assembler -c a.c"));
+	EXPECT_FALSE(compiles("lci gcc -c conftest.c"));
+	EXPECT_FALSE(compiles("lci gcc -c CMakeFiles/CMakeTmp/src.c"));
+}
+
+static std::string translated(char const *line)
+{
+	char buf[256];
+	char lint[] = "flint";
+	char *argv[32];
+	char **vec;
+	int argc = 0;
+	char *tok;
+	std::string joined;
+	int i;
+
+	(void)strcpy(buf, line);
+	for (tok = strtok(buf, " "); tok != NULL; tok = strtok(NULL, " "))
+		argv[argc++] = tok;
+	argv[argc] = NULL;
+	vec = lint_args(lint, argc, argv);
+	for (i = 0; vec[i] != NULL; ++i)
+		joined += (0 == i) ? vec[i] : std::string(" ") + vec[i];
+	free(vec);
+	return joined;
+}
+
+TEST(LintArgs, DropsCompilerOnlyFlags)
+{
+	EXPECT_THAT(translated("gcc"), StrEq("flint"));
+	EXPECT_THAT(translated("gcc -c -O2 -g -Wall -fPIC -o a.o a.c"),
+		    StrEq("flint a.c"));
+	EXPECT_THAT(translated("gcc -MD -MF a.d -MT a.o -c a.c -x c"),
+		    StrEq("flint a.c"));
+	EXPECT_THAT(translated("gcc -std=c4x -mavx2 -c a.c"),
+		    StrEq("flint a.c"));
+}
+
+TEST(LintArgs, MapsPreprocessorAndTargetFlags)
+{
+	EXPECT_THAT(translated("gcc -Iinc -I other -DX=1 -D Y -UZ -U W a.c"),
+		    StrEq("flint -iinc -iother -dX=1 -dY -uZ -uW a.c"));
+	EXPECT_THAT(translated("g++ -isystem /sys -include cfg.h b.cpp"),
+		    StrEq("flint -i/sys +libdir(/sys) -header(cfg.h) b.cpp"));
+	EXPECT_THAT(translated("gcc -std=gnu99 -m64 -funsigned-char a.c"),
+		    StrEq("flint -A(C99) -sl8 -sp8 +fcu a.c"));
+	EXPECT_THAT(translated("gcc -iquoteq -isystem/s -idirafterd a.c"),
+		    StrEq("flint -iq -i/s +libdir(/s) -id a.c"));
+	EXPECT_THAT(translated("gcc -std=c2x a.c"), StrEq("flint -A(C2023) a.c"));
+	EXPECT_THAT(translated("g++ -std=c++20 b.cpp"),
+		    StrEq("flint -A(C++2020) b.cpp"));
+	EXPECT_THAT(translated("g++ -std=gnu++2b b.cpp"),
+		    StrEq("flint -A(C++2023) b.cpp"));
+}
+
+TEST(LintArgs, OptionsBeforeSources)
+{
+	EXPECT_THAT(translated("gcc a.c -DA b.c -I inc c.c"),
+		    StrEq("flint -dA -iinc a.c b.c c.c"));
+	EXPECT_THAT(translated("gcc -I"), StrEq("flint"));
+}
+
+static std::string depfile_for(char const *line, int *given)
+{
+	char buf[256];
+	char *argv[32];
+	int argc = 0;
+	char *tok;
+	char *path;
+	std::string ret;
+
+	(void)strcpy(buf, line);
+	for (tok = strtok(buf, " "); tok != NULL; tok = strtok(NULL, " "))
+		argv[argc++] = tok;
+	argv[argc] = NULL;
+	path = dependency_file(argv, given);
+	ret = (path != NULL) ? path : "(null)";
+	free(path);
+	return ret;
+}
+
+TEST(DependencyFile, NamedLikeGcc)
+{
+	int given;
+
+	EXPECT_THAT(depfile_for("gcc -c a.c", &given), StrEq("(null)"));
+	EXPECT_THAT(given, Eq(0));
+	EXPECT_THAT(depfile_for("gcc -MD -MF x.d -c a.c", &given),
+		    StrEq("x.d"));
+	EXPECT_THAT(given, Eq(1));
+	EXPECT_THAT(depfile_for("gcc -MD -c s/a.c -o o/a.o", &given),
+		    StrEq("o/a.d"));
+	EXPECT_THAT(depfile_for("gcc -MD -c s/a.c", &given), StrEq("a.d"));
+	EXPECT_THAT(depfile_for("gcc -MMD -c a.c", &given), StrEq("(null)"));
+	EXPECT_THAT(given, Eq(1));
+	EXPECT_THAT(depfile_for("gcc -Wp,-MD,a.d -c a.c", &given),
+		    StrEq("(null)"));
+	EXPECT_THAT(given, Eq(1));
+}
+
+TEST(LintObject, NextToObjectFile)
+{
+	char arg0[] = "gcc";
+	char arg1[] = "-c";
+	char arg2[] = "src/a.c";
+	char arg3[] = "-oobj/a.o";
+	char *argv[] = { arg0, arg1, arg2, arg3, NULL };
+	char lint[] = "flint";
+	char *lint_argv[] = { lint, arg2, NULL };
+	char *lob;
+	char **vec;
+
+	lob = lint_object_file(4, argv);
+	EXPECT_THAT(lob, StrEq("obj/a.lob"));
+	vec = lint_object_output(lint_argv, lob);
+	EXPECT_THAT(vec[0], StrEq("flint"));
+	EXPECT_THAT(vec[1], StrEq("-oo(obj/a.lob)"));
+	EXPECT_THAT(vec[2], StrEq("src/a.c"));
+	EXPECT_THAT(vec[3], IsNull());
+	free(vec);
+	free(lob);
+	lob = lint_object_file(3, argv);
+	EXPECT_THAT(lob, StrEq("a.lob"));
+	free(lob);
+	argv[1] = arg2;
+	EXPECT_THAT(lint_object_file(2, argv), IsNull());
+}
+
+static void write_file(char const *path, char const *text)
+{
+	FILE *f = fopen(path, "w");
+
+	ASSERT_THAT(f, NotNull());
+	(void)fputs(text, f);
+	(void)fclose(f);
+}
+
+/*
+ * A directory of its own for a test that runs the programs of the build
+ */
+static std::string temp_dir(void)
+{
+	char dir[] = "/tmp/lci-test-XXXXXX";
+
+	return (mkdtemp(dir) != NULL) ? dir : "";
+}
+
+static void remove_dir(std::string const &dir)
+{
+	std::string const command = "rm -rf '" + dir + "'";
+
+	(void)system(command.c_str());
+}
+
+/*
+ * unit_test is built next to lci and the fake tools
+ */
+static std::string build_dir(void)
+{
+	char path[4096];
+	ssize_t const n = readlink("/proc/self/exe", path, sizeof(path) - 1u);
+	char *slash;
+
+	if (n <= 0)
+		return ".";
+	path[n] = '\0';
+	slash = strrchr(path, '/');
+	if (slash != NULL)
+		*slash = '\0';
+	return path;
+}
+
+/*
+ * What the child wrote to the read end fd of its output pipe, returns its
+ * exit code
+ */
+static int child_output(pid_t pid, int fd, std::string *out)
+{
+	char buf[4096];
+	int status;
+	ssize_t n;
+
+	out->clear();
+	while ((n = read(fd, buf, sizeof(buf))) != 0)
+		if (n > 0)
+			out->append(buf, (size_t)n);
+		else if (errno != EINTR)
+			break;
+	(void)close(fd);
+	if (-1 == pid || waitpid(pid, &status, 0) != pid)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) :
+	    128 + WTERMSIG(status);
+}
+
+/*
+ * The child runs in dir with the build directory first in PATH and its
+ * stdout and stderr going to fds[1]
+ */
+static void enter_child(std::string const &dir, int fds[2])
+{
+	char const *const path = getenv("PATH");
+	std::string const search =
+	    build_dir() + ":" + ((path != NULL) ? path : "/bin");
+
+	(void)close(fds[0]);
+	(void)dup2(fds[1], STDOUT_FILENO);
+	(void)dup2(fds[1], STDERR_FILENO);
+	if (chdir(dir.c_str()) != 0)
+		_exit(127);
+	(void)setenv("PATH", search.c_str(), 1);
+	/*
+	 * a make running the tests must not lend its job slots
+	 */
+	(void)unsetenv("MAKEFLAGS");
+}
+
+/*
+ * Starts argv[0], a program of the build, in dir with the build directory
+ * first in PATH and env, NAME=value strings, added to the environment.
+ * Its stdout and stderr go to fds[1].
+ */
+static pid_t start_built(std::string const &dir, char const *const env[],
+			 char const *const argv[], int fds[2])
+{
+	std::string const program = build_dir() + "/" + argv[0];
+	pid_t const pid = fork();
+
+	if (0 == pid) {
+		int i;
+
+		enter_child(dir, fds);
+		for (i = 0; env != NULL && env[i] != NULL; ++i)
+			(void)putenv(const_cast<char *>(env[i]));
+		(void)execv(program.c_str(), const_cast<char *const *>(argv));
+		_exit(127);
+	}
+	return pid;
+}
+
+/*
+ * Returns the exit code of argv[0] run as by start_built, out gets what
+ * it wrote to stdout and stderr
+ */
+static int run_built(std::string const &dir, char const *const env[],
+		     char const *const argv[], std::string *out)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) != 0)
+		return -1;
+	pid = start_built(dir, env, argv, fds);
+	(void)close(fds[1]);
+	return child_output(pid, fds[0], out);
+}
+
+TEST(ResponseFiles, NothingToExpand)
+{
+	char arg0[] = "gcc";
+	char arg1[] = "a.c";
+	char *argv[] = { arg0, arg1, NULL };
+	int argc = ARGV_COUNT(argv);
+
+	EXPECT_THAT(expand_response_files(&argc, argv), Eq(argv));
+	EXPECT_THAT(argc, Eq(2));
+}
+
+TEST(ResponseFiles, QuotingAndNesting)
+{
+	char outer[] = "/tmp/lci-test-outer.rsp";
+	char arg0[] = "gcc";
+	char arg1[128];
+	char arg2[] = "@/nonexistent.rsp";
+	char *argv[] = { arg0, arg1, arg2, NULL };
+	int argc = ARGV_COUNT(argv);
+	char **args;
+
+	write_file("/tmp/lci-test-inner.rsp", "-DX=\"a b\"\n'-I my dir'");
+	write_file(outer, " -c\t@/tmp/lci-test-inner.rsp a\\ b.c\n");
+	(void)sprintf(arg1, "@%s", outer);
+	args = expand_response_files(&argc, argv);
+	ASSERT_THAT(argc, Eq(6));
+	EXPECT_THAT(args[0], StrEq("gcc"));
+	EXPECT_THAT(args[1], StrEq("-c"));
+	EXPECT_THAT(args[2], StrEq("-DX=a b"));
+	EXPECT_THAT(args[3], StrEq("-I my dir"));
+	EXPECT_THAT(args[4], StrEq("a b.c"));
+	EXPECT_THAT(args[5], StrEq("@/nonexistent.rsp"));
+	EXPECT_THAT(args[6], IsNull());
+	free(args);
+	(void)remove("/tmp/lci-test-inner.rsp");
+	(void)remove(outer);
+}
+
+TEST(ResponseFiles, ShortLintCommandLineUnchanged)
+{
+	char arg0[] = "flint";
+	char arg1[] = "-dX";
+	char *argv[] = { arg0, arg1, NULL };
+
+	EXPECT_THAT(lint_response_args(argv), Eq(argv));
+}
+
+static std::string read_text(char const *path)
+{
+	std::string text;
+	char buf[4096];
+	size_t n;
+	FILE *f = fopen(path, "r");
+
+	if (NULL == f)
+		return text;
+	while ((n = fread(buf, 1u, sizeof(buf), f)) != 0)
+		text.append(buf, n);
+	(void)fclose(f);
+	return text;
+}
+
+/*
+ * The indirect file is in the private directory of the user, quotes and
+ * backslashes in a quoted option are escaped, a planted file is replaced
+ */
+TEST(ResponseFiles, LongLintCommandLineEscaped)
+{
+	std::string const dir = temp_dir();
+	std::string const pad = "-i" + std::string(130u * 1024u, 'x');
+	char *const old_tmpdir = getenv("TMPDIR");
+	std::string const saved = (old_tmpdir != NULL) ? old_tmpdir : "";
+	char arg0[] = "flint";
+	char msg[] = "-dMSG=\"a b\"";
+	char win[] = "-dP=c:\\x y";
+	char src[] = "a.c";
+	char *argv[] = { arg0, const_cast<char *>(pad.c_str()), msg, win, src,
+		NULL
+	};
+	struct stat st;
+	std::string text;
+	std::string path;
+	char **args;
+
+	(void)setenv("TMPDIR", dir.c_str(), 1);
+	args = lint_response_args(argv);
+	ASSERT_THAT(args, Ne(argv));
+	EXPECT_THAT(args[0], StrEq("flint"));
+	EXPECT_THAT(args[2], StrEq("a.c"));
+	path = args[1];
+	free(args);
+	EXPECT_THAT(path.find(dir + "/lci-"), Eq(0u));
+	ASSERT_THAT(stat(path.substr(0, path.rfind('/')).c_str(), &st), Eq(0));
+	EXPECT_THAT(st.st_mode & 0777, Eq(0700u));
+	text = read_text(path.c_str());
+	EXPECT_THAT(text, HasSubstr("\n\"-dMSG=\\\"a b\\\"\"\n"));
+	EXPECT_THAT(text, HasSubstr("\n\"-dP=c:\\\\x y\"\n"));
+
+	ASSERT_THAT(unlink(path.c_str()), Eq(0));
+	ASSERT_THAT(symlink("/dev/null", path.c_str()), Eq(0));
+	free(lint_response_args(argv));
+	ASSERT_THAT(lstat(path.c_str(), &st), Eq(0));
+	EXPECT_TRUE(S_ISREG(st.st_mode));
+	EXPECT_THAT(read_text(path.c_str()), StrEq(text));
+
+	if (old_tmpdir != NULL)
+		(void)setenv("TMPDIR", saved.c_str(), 1);
+	else
+		(void)unsetenv("TMPDIR");
+	remove_dir(dir);
+}
+
+TEST(ManifestScan, Depfile)
+{
+	char path[] = "/tmp/lci-test.d";
+	struct manifest_scan scan;
+	std::string files;
+	size_t i;
+
+	write_file(path, "o/a.o: a.c inc/a\\ b.h \\\n /usr/include/$$x.h\n"
+		   "inc/a\\ b.h:\n");
+	manifest_scan_init(&scan);
+	EXPECT_THAT(manifest_scan_depfile(&scan, path), Eq(1));
+	EXPECT_THAT(scan.count, Eq(3u));
+	for (i = 0; i != scan.capacity; ++i)
+		if (scan.files[i] != NULL)
+			files += std::string("[") + scan.files[i] + "]";
+	EXPECT_THAT(files, HasSubstr("[a.c]"));
+	EXPECT_THAT(files, HasSubstr("[inc/a b.h]"));
+	EXPECT_THAT(files, HasSubstr("[/usr/include/$x.h]"));
+	manifest_scan_free(&scan);
+	(void)remove(path);
+}
+
+static unsigned long fingerprint_of(char const *line)
+{
+	unsigned long fp = 0;
+
+	return dedup_fingerprint(line, &fp) ? fp : 0;
+}
+
+TEST(Dedup, Fingerprint)
+{
+	unsigned long const fp = fingerprint_of("h.h  3  Warning 534: f");
+
+	EXPECT_THAT(fp, Ne(0ul));
+	EXPECT_THAT(fingerprint_of("h.h(3): Warning 534: other text"), Eq(fp));
+	EXPECT_THAT(fingerprint_of("h.h:3: warning 534: f"), Eq(fp));
+	EXPECT_THAT(fingerprint_of("h.h  4  Warning 534: f"), Ne(fp));
+	EXPECT_THAT(fingerprint_of("h.h  3  Warning 533: f"), Ne(fp));
+	EXPECT_THAT(fingerprint_of("--- Module:   a.c (C)"), Eq(0ul));
+	EXPECT_THAT(fingerprint_of("    Info 714: Symbol 'y'"),
+		    Ne(fingerprint_of("    Info 714: Symbol 'z'")));
+}
+
+TEST(Trace, ParseRecord)
+{
+	struct trace_record rec;
+
+	ASSERT_TRUE(trace_parse("LT2 10 11 L flint 1700000000.000042 1500 900 "
+				"300 20480 1 /src/a.c\n", &rec));
+	EXPECT_THAT(rec.lci_pid, Eq(10));
+	EXPECT_THAT(rec.pid, Eq(11));
+	EXPECT_THAT(rec.role, Eq(TRACE_LINT));
+	EXPECT_THAT(rec.name, StrEq("flint"));
+	EXPECT_THAT(rec.start_sec, Eq(1700000000));
+	EXPECT_THAT(rec.start_usec, Eq(42));
+	EXPECT_THAT(rec.wall_us, Eq(1500u));
+	EXPECT_THAT(rec.user_us, Eq(900u));
+	EXPECT_THAT(rec.sys_us, Eq(300u));
+	EXPECT_THAT(rec.maxrss_kb, Eq(20480));
+	EXPECT_THAT(rec.code, Eq(1));
+	EXPECT_THAT(rec.unit, StrEq("/src/a.c"));
+	EXPECT_FALSE(trace_parse("LT2 10 11 C gcc\n", &rec));
+	EXPECT_FALSE(trace_parse("lci: warning\n", &rec));
+}
+
+/*
+ * Two lci runs, one compiled and linted, one only linted
+ */
+TEST(Stats, Totals)
+{
+	std::string const dir = temp_dir();
+	char const *const argv[] = { "lci-stats", "trace", NULL };
+	std::string out;
+
+	write_file((dir + "/trace").c_str(),
+		   "LT2 10 11 C gcc 1.0 2000000 1000000 0 100 0 /src/a/x.c\n"
+		   "LT2 10 13 P gcc 1.0 200000 100000 0 100 0 /src/a/x.c\n"
+		   "LT2 10 12 L flint 1.0 1500000 900000 100000 100 0 "
+		   "/src/a/x.c\n"
+		   "LT2 10 10 S lci 1.0 3000000 100000 0 100 -1 /src/a/x.c\n"
+		   "LT2 20 21 L flint 1.0 500000 500000 0 100 1 /src/b/y.c\n"
+		   "LT2 20 20 S lci 1.0 600000 100000 0 100 -1 /src/b/y.c\n");
+	EXPECT_THAT(run_built(dir, NULL, argv, &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr(
+		"  compile            1        2.000        1.000\n"
+		"  preprocess         1        0.200        0.100\n"
+		"  lint               2        2.000        1.500\n"
+		"  lci                2        3.600        0.200\n"
+		"  lint added 1.600 s wall to compile steps\n"));
+	EXPECT_THAT(out, HasSubstr("         1.500  /src/a/x.c\n"
+				   "         0.500  /src/b/y.c\n"));
+	EXPECT_THAT(out, HasSubstr(
+		"      1.00        1.000        1.000  /src/a\n"
+		"         -        0.500        0.000  /src/b\n"));
+	remove_dir(dir);
+}
+
+/*
+ * Counts the records of each role in the trace file at path, all must be
+ * of the lci run whose own record is there
+ */
+static void count_roles(std::string const &path, int counts[128])
+{
+	std::string const text = read_text(path.c_str());
+	struct trace_record rec;
+	std::string::size_type at = 0;
+	std::string::size_type end;
+	long lci_pid = 0;
+
+	(void)memset(counts, 0, 128 * sizeof(*counts));
+	for (; (end = text.find('\n', at)) != std::string::npos; at = end + 1) {
+		ASSERT_TRUE(trace_parse(text.substr(at, end + 1 - at).c_str(),
+					&rec));
+		++counts[rec.role & 127];
+		if (TRACE_LCI == rec.role)
+			lci_pid = rec.lci_pid;
+	}
+	for (at = 0; (end = text.find('\n', at)) != std::string::npos;
+	     at = end + 1) {
+		(void)trace_parse(text.substr(at, end + 1 - at).c_str(), &rec);
+		EXPECT_THAT(rec.lci_pid, Eq(lci_pid));
+	}
+}
+
+/*
+ * The preprocessor run of the lint cache is not a compile and the lint
+ * left in the background does not account lci a second time
+ */
+TEST(Trace, BackgroundLintIsOneRun)
+{
+	std::string const dir = temp_dir();
+	std::string const trace = "LCI_TRACE=" + dir + "/trace";
+	std::string const cache_dir = "LCI_CACHE_DIR=" + dir + "/cache";
+	std::string const results = "LCI_RESULTS=" + dir + "/results";
+	char const *const env[] = {
+		trace.c_str(), cache_dir.c_str(), results.c_str(), NULL
+	};
+	char const *const argv[] = { "lci", "-a", "cc", "-c", "a.c", NULL };
+	std::string out;
+	int counts[128];
+
+	write_file((dir + "/a.c").c_str(), "int a;\n");
+	ASSERT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	internal::CaptureStdout();
+	internal::CaptureStderr();
+	(void)async_wait((dir + "/results").c_str());
+	(void)internal::GetCapturedStdout();
+	(void)internal::GetCapturedStderr();
+	count_roles(dir + "/trace", counts);
+	EXPECT_THAT(counts[TRACE_LCI], Eq(1));
+	EXPECT_THAT(counts[TRACE_COMPILER], Eq(1));
+	EXPECT_THAT(counts[TRACE_PREPROCESSOR], Eq(1));
+	EXPECT_THAT(counts[TRACE_LINT], Eq(1));
+	remove_dir(dir);
+}
+
+TEST(Trace, ServerLintIsRecorded)
+{
+	std::string const dir = temp_dir();
+	std::string const trace = "LCI_TRACE=" + dir + "/trace";
+	std::string const server = "LCI_SERVER=" + dir + "/lci.sock";
+	char const *const env[] = { trace.c_str(), server.c_str(), NULL };
+	char const *const server_argv[] = { "lci", "--server", NULL };
+	char const *const argv[] = { "lci", "cc", "-c", "a.c", NULL };
+	int fds[2] = { -1, -1 };
+	int tries;
+	int sock = -1;
+	int counts[128];
+	std::string out;
+	pid_t pid;
+
+	write_file((dir + "/a.c").c_str(), "int a;\n");
+	fds[1] = open("/dev/null", O_WRONLY);
+	pid = start_built(dir, env, server_argv, fds);
+	(void)close(fds[1]);
+	for (tries = 0; tries != 100 && -1 == sock; ++tries) {
+		(void)usleep(10000);
+		sock = lint_server_connect((dir + "/lci.sock").c_str());
+	}
+	ASSERT_THAT(sock, Ne(-1));
+	(void)close(sock);
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("This is `fake-lint-nt.exe'"));
+	count_roles(dir + "/trace", counts);
+	EXPECT_THAT(counts[TRACE_LCI], Eq(1));
+	EXPECT_THAT(counts[TRACE_LINT], Eq(1));
+	(void)kill(pid, SIGTERM);
+	(void)waitpid(pid, NULL, 0);
+	remove_dir(dir);
+}
+
+TEST(Wire, ArgvRoundTrip)
+{
+	char arg0[] = "fake-flint";
+	char arg1[] = "";
+	char arg2[] = "-u";
+	char *argv[] = { arg0, arg1, arg2, NULL };
+	struct wire_buf buf = { NULL, 0, 0 };
+	char **unpacked;
+	char *cwd;
+
+	wire_pack_argv(&buf, "/src", argv);
+	unpacked = wire_unpack_argv(&buf, &cwd);
+	ASSERT_THAT(unpacked, NotNull());
+	EXPECT_THAT(cwd, StrEq("/src"));
+	EXPECT_THAT(unpacked[0], StrEq("fake-flint"));
+	EXPECT_THAT(unpacked[1], StrEq(""));
+	EXPECT_THAT(unpacked[2], StrEq("-u"));
+	EXPECT_THAT(unpacked[3], IsNull());
+	free(unpacked);
+	wire_buf_free(&buf);
+}
+
+/*
+ * The cache does not trust files changed in the second lci starts in
+ */
+static void write_file_before_run(char const *path, char const *text)
+{
+	write_file(path, text);
+	(void)sleep(1);
+}
+
+/*
+ * A header switched to another version and back, as by git checkout, has
+ * new times but the same content.  The direct mode manifest is of the
+ * other version now, the key made from the dependency file still finds
+ * the result.
+ */
+TEST(LintCache, DependKeyIgnoresTouchedFiles)
+{
+	std::string const dir = temp_dir();
+	std::string const cache_dir = "LCI_CACHE_DIR=" + dir + "/cache";
+	std::string const header = dir + "/h.h";
+	char const *const first_env[] = {
+		cache_dir.c_str(), "FAKE_EXIT=3", NULL
+	};
+	char const *const other_env[] = {
+		cache_dir.c_str(), "FAKE_EXIT=5", NULL
+	};
+	char const *const hit_env[] = { cache_dir.c_str(), NULL };
+	char const *const argv[] = { "lci", "cc", "-c", "a.c", NULL };
+	std::string out;
+
+	write_file((dir + "/a.c").c_str(), "#include \"h.h\"\n");
+	write_file_before_run(header.c_str(), "int h = 1;\n");
+	EXPECT_THAT(run_built(dir, first_env, argv, &out), Eq(3));
+	write_file_before_run(header.c_str(), "int h = 2;\n");
+	EXPECT_THAT(run_built(dir, other_env, argv, &out), Eq(5));
+	write_file_before_run(header.c_str(), "int h = 1;\n");
+	EXPECT_THAT(run_built(dir, hit_env, argv, &out), Eq(3));
+	remove_dir(dir);
+}
+
+TEST(ParallelLint, FailedCompileStopsLint)
+{
+	std::string const dir = temp_dir();
+	char const *const env[] = { "FAKE_LATENCY_MS=30000", NULL };
+	char const *const argv[] = { "lci", "-p", "cc", "-c", "bad.c", NULL };
+	std::string out;
+
+	write_file((dir + "/bad.c").c_str(), "int x = ;\n");
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(1));
+	EXPECT_THAT(out, Not(HasSubstr("This is `fake-lint-nt.exe'")));
+	remove_dir(dir);
+}
+
+TEST(ParallelLint, ForceLintFinishesLint)
+{
+	std::string const dir = temp_dir();
+	char const *const env[] = { "FAKE_LATENCY_MS=200", NULL };
+	char const *const argv[] = {
+		"lci", "-p", "-f", "cc", "-c", "bad.c", NULL
+	};
+	std::string out;
+
+	write_file((dir + "/bad.c").c_str(), "int x = ;\n");
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(1));
+	EXPECT_THAT(out, HasSubstr("End of `fake-lint-nt.exe'"));
+	remove_dir(dir);
+}
+
+TEST(ParallelLint, FailedCompileExitCodeWins)
+{
+	std::string const dir = temp_dir();
+	char const *const env[] = { "FAKE_EXIT=7", NULL };
+	char const *const bad[] = {
+		"lci", "-p", "-f", "cc", "-c", "bad.c", NULL
+	};
+	char const *const good[] = { "lci", "-p", "cc", "-c", "good.c", NULL };
+	std::string out;
+
+	write_file((dir + "/bad.c").c_str(), "int x = ;\n");
+	write_file((dir + "/good.c").c_str(), "int x = 1;\n");
+	EXPECT_THAT(run_built(dir, env, bad, &out), Eq(1));
+	EXPECT_THAT(run_built(dir, env, good, &out), Eq(7));
+	remove_dir(dir);
+}
+
+/*
+ * The second run gets what lint printed and its exit code from the cache,
+ * not from lint, which would now say nothing and succeed
+ */
+TEST(LintCache, MissThenHit)
+{
+	std::string const dir = temp_dir();
+	std::string const cache_dir = "LCI_CACHE_DIR=" + dir + "/cache";
+	char const *const miss_env[] = {
+		cache_dir.c_str(), "FAKE_OUTPUT_LINES=2", "FAKE_EXIT=3", NULL
+	};
+	char const *const hit_env[] = {
+		cache_dir.c_str(), "FAKE_QUIET=1", NULL
+	};
+	char const *const argv[] = { "lci", "cc", "-c", "a.c", NULL };
+	std::string miss;
+	std::string hit;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	EXPECT_THAT(run_built(dir, miss_env, argv, &miss), Eq(3));
+	EXPECT_THAT(miss, HasSubstr("a.c  2  Info 765"));
+	EXPECT_THAT(run_built(dir, hit_env, argv, &hit), Eq(3));
+	EXPECT_THAT(hit, StrEq(miss));
+	remove_dir(dir);
+}
+
+/*
+ * A store that fills its shard evicts the oldest entry there, whatever
+ * the name of the stored entry
+ */
+TEST(LintCache, StoreEvictsFromFullShard)
+{
+	std::string const dir = temp_dir();
+	std::string const cache = dir + "/cache";
+	std::string const cache_dir = "LCI_CACHE_DIR=" + cache;
+	char const *const env[] = {
+		cache_dir.c_str(), "LCI_CACHE_SIZE=16k", "LCI_NODIRECT=1", NULL
+	};
+	char const *const sources[] = { "a.c", "b.c", "c.c" };
+	struct utimbuf const old_times = { 1000, 1000 };
+	std::string const old(2048u, 'x');
+	std::string out;
+	int stored = 0;
+	int i;
+
+	ASSERT_THAT(mkdir(cache.c_str(), 0777), Eq(0));
+	for (i = 0; i != 16; ++i) {
+		std::string const shard = cache + "/" + "0123456789abcdef"[i];
+
+		ASSERT_THAT(mkdir(shard.c_str(), 0777), Eq(0));
+		write_file((shard + "/old").c_str(), old.c_str());
+		ASSERT_THAT(utime((shard + "/old").c_str(), &old_times), Eq(0));
+	}
+	for (i = 0; i != 3; ++i) {
+		char const *const argv[] = { "lci", "cc", "-c", sources[i],
+			NULL
+		};
+
+		write_file((dir + "/" + sources[i]).c_str(),
+			   (std::string("int ") + sources[i][0] +
+			    " = 1;\n").c_str());
+		EXPECT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	}
+	for (i = 0; i != 16; ++i) {
+		std::string const shard = cache + "/" + "0123456789abcdef"[i];
+
+		if (access((shard + "/.added").c_str(), F_OK) == 0) {
+			EXPECT_THAT(access((shard + "/old").c_str(), F_OK),
+				    Eq(-1)) << shard;
+			++stored;
+		}
+	}
+	EXPECT_THAT(stored, Ne(0));
+	remove_dir(dir);
+}
+
+extern "C" char **environ;
+
+typedef int exec_fn(char const *file, char *const argv[],
+		     char *const envp[]);
+
+/*
+ * A build tool with liblci-preload.so runs the compiler with execvpe.  lci
+ * is started as a program, the buffered output of the tool is lost with
+ * the exec, as without the library, not written by lci.
+ */
+TEST(Preload, CompilerExecStartsLci)
+{
+	std::string const dir = temp_dir();
+	std::string const lci = "LCI_PROGRAM=" + build_dir() + "/lci";
+	std::string const library = build_dir() + "/liblci-preload.so";
+	std::string out;
+	int fds[2];
+	pid_t pid;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	ASSERT_THAT(pipe(fds), Eq(0));
+	pid = fork();
+	if (0 == pid) {
+		char cc[] = "cc";
+		char c[] = "-c";
+		char src[] = "a.c";
+		char *argv[] = { cc, c, src, NULL };
+		void *handle;
+		exec_fn *next;
+
+		enter_child(dir, fds);
+		(void)putenv(const_cast<char *>(lci.c_str()));
+		handle = dlopen(library.c_str(), RTLD_NOW);
+		if (NULL == handle)
+			_exit(126);
+		next = (exec_fn *)dlsym(handle, "execvpe");
+		(void)printf("host buffer\n");
+		(void)next(cc, argv, environ);
+		_exit(127);
+	}
+	(void)close(fds[1]);
+	EXPECT_THAT(child_output(pid, fds[0], &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("This is `fake-lint-nt.exe'"));
+	EXPECT_THAT(out, Not(HasSubstr("host buffer")));
+	remove_dir(dir);
+}
+
+/*
+ * Only liblci-preload.so is taken out of LD_PRELOAD for lci, the compiler
+ * is a script that shows what is left
+ */
+TEST(Preload, OtherPreloadsStay)
+{
+	std::string const dir = temp_dir();
+	std::string const lci = "LCI_PROGRAM=" + build_dir() + "/lci";
+	std::string const library = build_dir() + "/liblci-preload.so";
+	std::string const preload = "LD_PRELOAD=libm.so.6:" + library +
+	    " libdl.so.2";
+	std::string const cc = dir + "/cc";
+	std::string out;
+	int fds[2];
+	pid_t pid;
+
+	write_file(cc.c_str(), "#!/bin/sh\necho \"preload=$LD_PRELOAD\"\n");
+	ASSERT_THAT(chmod(cc.c_str(), 0755), Eq(0));
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	ASSERT_THAT(pipe(fds), Eq(0));
+	pid = fork();
+	if (0 == pid) {
+		char c[] = "-c";
+		char src[] = "a.c";
+		char *argv[] = { const_cast<char *>(cc.c_str()), c, src, NULL };
+		void *handle;
+		exec_fn *next;
+
+		enter_child(dir, fds);
+		(void)putenv(const_cast<char *>(lci.c_str()));
+		(void)putenv(const_cast<char *>(preload.c_str()));
+		handle = dlopen(library.c_str(), RTLD_NOW);
+		if (NULL == handle)
+			_exit(126);
+		next = (exec_fn *)dlsym(handle, "execve");
+		(void)next(cc.c_str(), argv, environ);
+		_exit(127);
+	}
+	(void)close(fds[1]);
+	EXPECT_THAT(child_output(pid, fds[0], &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("preload=libm.so.6:libdl.so.2\n"));
+	remove_dir(dir);
+}
+
+static int count_entries(std::string const &dir, char const *prefix)
+{
+	DIR *d = opendir(dir.c_str());
+	struct dirent *e;
+	int count = 0;
+
+	if (NULL == d)
+		return -1;
+	while ((e = readdir(d)) != NULL)
+		if (strncmp(e->d_name, prefix, strlen(prefix)) == 0)
+			++count;
+	(void)closedir(d);
+	return count;
+}
+
+/*
+ * The flush lints in the directory of the compile, the taken queue is
+ * still removed from the directory of the flush
+ */
+TEST(LintQueue, FlushRemovesRelativeQueue)
+{
+	std::string const dir = temp_dir();
+	char const *const compile_env[] = { "LCI_QUEUE=../queue", NULL };
+	char const *const flush_env[] = { "LCI_QUEUE=queue", NULL };
+	char const *const compile[] = {
+		"lci", "-q", "cc", "-c", "a.c", NULL
+	};
+	char const *const flush[] = { "lci", "--flush-lint", NULL };
+	std::string out;
+
+	ASSERT_THAT(mkdir((dir + "/sub").c_str(), 0777), Eq(0));
+	write_file((dir + "/sub/a.c").c_str(), "int a = 1;\n");
+	EXPECT_THAT(run_built(dir + "/sub", compile_env, compile, &out), Eq(0));
+	EXPECT_THAT(count_entries(dir, "queue"), Eq(1));
+	EXPECT_THAT(run_built(dir, flush_env, flush, &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("argv[1]: `a.c'"));
+	EXPECT_THAT(count_entries(dir, "queue"), Eq(0));
+	remove_dir(dir);
+}
+
+TEST(LintServer, NoServer)
+{
+	EXPECT_THAT(lint_server_connect(NULL), Eq(-1));
+	EXPECT_THAT(lint_server_connect("/nonexistent/lci.sock"), Eq(-1));
+}
+
+TEST(LintServer, RunsLint)
+{
+	char path[64];
+	char arg0[] = "sh";
+	char arg1[] = "-c";
+	char arg2[] = "echo out; exit 3";
+	char *argv[] = { arg0, arg1, arg2, NULL };
+	int sock = -1;
+	int tries;
+	pid_t server;
+
+	(void)sprintf(path, "/tmp/lci-test-%ld.sock", (long)getpid());
+	server = fork();
+	ASSERT_THAT(server, Ne(-1));
+	if (0 == server)
+		_exit(lint_server_main(path, 1));
+	for (tries = 0; tries != 100 && -1 == sock; ++tries) {
+		(void)usleep(10000);
+		sock = lint_server_connect(path);
+	}
+	ASSERT_THAT(sock, Ne(-1));
+	internal::CaptureStdout();
+	EXPECT_THAT(lint_server_run(sock, argv), Eq(3));
+	(void)fflush(stdout);
+	EXPECT_THAT(internal::GetCapturedStdout(), StrEq("out\n"));
+	(void)close(sock);
+	(void)kill(server, SIGTERM);
+	(void)waitpid(server, NULL, 0);
+}
+
+TEST(LintWorker, NoWorker)
+{
+	EXPECT_THAT(lint_worker_connect("127.0.0.1:1"), Eq(-1));
+	EXPECT_THAT(lint_worker_connect("no-port"), Eq(-1));
+}
+
+TEST(LintWorker, LintsPreprocessedSource)
+{
+	char address[32];
+	char source[64];
+	char cc[] = "cc";
+	char lint[] = "lint";
+	char *compiler_argv[] = { cc, source, NULL };
+	char *lint_argv[] = { lint, source, NULL };
+	int const port = 20000 + (int)(getpid() % 20000);
+	int sock = -1;
+	int tries;
+	FILE *f;
+	pid_t worker;
+
+	(void)sprintf(address, "127.0.0.1:%d", port);
+	(void)sprintf(source, "/tmp/lci-test-%ld.c", (long)getpid());
+	f = fopen(source, "w");
+	ASSERT_THAT(f, NotNull());
+	(void)fputs("#define X 42\nint x = X;\n", f);
+	(void)fclose(f);
+	worker = fork();
+	ASSERT_THAT(worker, Ne(-1));
+	if (0 == worker)
+		_exit(lint_worker_main(address, 1, "cat"));
+	for (tries = 0; tries != 100 && -1 == sock; ++tries) {
+		(void)usleep(10000);
+		sock = lint_worker_connect(address);
+	}
+	ASSERT_THAT(sock, Ne(-1));
+	internal::CaptureStdout();
+	EXPECT_THAT(lint_worker_run(sock, compiler_argv, lint_argv), Eq(0));
+	(void)fflush(stdout);
+	EXPECT_THAT(internal::GetCapturedStdout(), HasSubstr("int x = 42;"));
+	(void)close(sock);
+	(void)unlink(source);
+	(void)kill(worker, SIGTERM);
+	(void)waitpid(worker, NULL, 0);
+}
+
+/*
+ * A socket on 127.0.0.1:port, listening or connected
+ */
+static int loopback_socket(int port, int listening)
+{
+	struct sockaddr_in addr;
+	int const sock = socket(AF_INET, SOCK_STREAM, 0);
+	int const on = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	(void)setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (listening ? bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0
+	    || listen(sock, 8) != 0 :
+	    connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		(void)close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+static int peer_port(int sock)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	if (getpeername(sock, (struct sockaddr *)&addr, &len) != 0)
+		return -1;
+	return ntohs(addr.sin_port);
+}
+
+/*
+ * A one job lci-worker with fake-flint on 127.0.0.1:port
+ */
+static pid_t start_lint_worker(int port)
+{
+	std::string const lint = build_dir() + "/fake-flint";
+	char address[32];
+	int sock = -1;
+	int tries;
+	pid_t worker;
+
+	(void)sprintf(address, "%d", port);
+	worker = fork();
+	if (0 == worker)
+		_exit(lint_worker_main(address, 1, lint.c_str()));
+	for (tries = 0; tries != 100 && -1 == sock; ++tries) {
+		(void)usleep(10000);
+		sock = loopback_socket(port, 0);
+	}
+	if (sock != -1)
+		(void)close(sock);
+	return worker;
+}
+
+/*
+ * The first worker is busy with a unit whose files are still coming, it
+ * tells so although its only lint process is taken
+ */
+TEST(LintWorker, LeastLoadedIsChosen)
+{
+	int const port = 20000 + (int)((getpid() + 7) % 20000);
+	char list[64];
+	char busy_list[32];
+	char source[64];
+	char cc[] = "cc";
+	char lint[] = "lint";
+	char *compiler_argv[] = { cc, source, NULL };
+	char *lint_argv[] = { lint, source, NULL };
+	pid_t const busy_worker = start_lint_worker(port);
+	pid_t const idle_worker = start_lint_worker(port + 1);
+	int busy;
+	int sock;
+
+	(void)sprintf(list, "127.0.0.1:%d,127.0.0.1:%d", port, port + 1);
+	(void)sprintf(busy_list, "127.0.0.1:%d", port);
+	(void)sprintf(source, "/tmp/lci-test-%ld.c", (long)getpid());
+	write_file(source, "int x = 1;\n");
+	busy = loopback_socket(port, 0);
+	EXPECT_THAT(busy, Ne(-1));
+	EXPECT_TRUE(wire_send(busy, WIRE_FILE, "a.c", 4u));
+	(void)usleep(100000);
+
+	sock = lint_worker_connect(list);
+	EXPECT_THAT(peer_port(sock), Eq(port + 1));
+	if (peer_port(sock) == port + 1) {
+		internal::CaptureStdout();
+		EXPECT_THAT(lint_worker_run(sock, compiler_argv, lint_argv),
+			    Eq(0));
+		(void)fflush(stdout);
+		EXPECT_THAT(internal::GetCapturedStdout(),
+			    HasSubstr("This is `fake-flint'"));
+	}
+	(void)close(sock);
+	sock = lint_worker_connect(busy_list);
+	EXPECT_THAT(sock, Ne(-1));
+	(void)close(sock);
+
+	(void)close(busy);
+	(void)unlink(source);
+	(void)kill(busy_worker, SIGTERM);
+	(void)kill(idle_worker, SIGTERM);
+	(void)waitpid(busy_worker, NULL, 0);
+	(void)waitpid(idle_worker, NULL, 0);
+}
+
+/*
+ * A worker that accepts but never answers the load query is given up on,
+ * lci lints locally
+ */
+TEST(LintWorker, FallsBackWhenNoWorkerAnswers)
+{
+	std::string const dir = temp_dir();
+	int const port = 20000 + (int)((getpid() + 11) % 20000);
+	int const mute = loopback_socket(port, 1);
+	char workers[48];
+	char const *const env[] = { workers, NULL };
+	char const *const argv[] = { "lci", "cc", "-c", "a.c", NULL };
+	std::string out;
+
+	ASSERT_THAT(mute, Ne(-1));
+	(void)sprintf(workers, "LCI_WORKERS=127.0.0.1:%d", port);
+	EXPECT_THAT(lint_worker_connect(&workers[sizeof("LCI_WORKERS")]),
+		    Eq(-1));
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("This is `fake-lint-nt.exe'"));
+	(void)close(mute);
+	remove_dir(dir);
+}
+
+TEST(Priority, CpuPressure)
+{
+	double avg10 = 0.0;
+
+	EXPECT_TRUE(parse_cpu_pressure(
+		"some avg10=12.50 avg60=3.00 avg300=1.00 total=123\n", &avg10));
+	EXPECT_THAT(avg10, DoubleEq(12.5));
+	EXPECT_FALSE(parse_cpu_pressure("full avg10=0.00\n", &avg10));
+}
+
+TEST(Async, WaitReportsResults)
+{
+	char dir[] = "/tmp/lci-test-XXXXXX";
+	char path[64];
+
+	ASSERT_THAT(mkdtemp(dir), NotNull());
+	(void)sprintf(path, "%s/1.aaaaaa", dir);
+	write_file(path, "first\n");
+	(void)strcat(path, ".exit");
+	write_file(path, "0\n");
+	(void)sprintf(path, "%s/2.bbbbbb", dir);
+	write_file(path, "second\n");
+	(void)strcat(path, ".exit");
+	write_file(path, "3\n");
+	internal::CaptureStdout();
+	internal::CaptureStderr();
+	EXPECT_THAT(async_wait(dir), Eq(EXIT_FAILURE));
+	EXPECT_THAT(internal::GetCapturedStdout(), StrEq("first\nsecond\n"));
+	EXPECT_THAT(internal::GetCapturedStderr(),
+		    HasSubstr("2 background lint runs, 1 failed"));
+	EXPECT_THAT(rmdir(dir), Eq(0));
+}
+
+/*
+ * A result still being created has a dot name and is left alone
+ */
+TEST(Async, DetachedResultIsWaitedFor)
+{
+	char dir[] = "/tmp/lci-test-XXXXXX";
+	char path[64];
+	int detached;
+
+	ASSERT_THAT(mkdtemp(dir), NotNull());
+	(void)sprintf(path, "%s/.1.aaaaaa", dir);
+	write_file(path, "not yet\n");
+	detached = async_detach(dir);
+	if (1 == detached) {
+		printf("background\n");
+		(void)fflush(stdout);
+		async_finish(EXIT_SUCCESS);
+		_exit(EXIT_SUCCESS);
+	}
+	ASSERT_THAT(detached, Eq(0));
+	internal::CaptureStdout();
+	internal::CaptureStderr();
+	EXPECT_THAT(async_wait(dir), Eq(EXIT_SUCCESS));
+	EXPECT_THAT(internal::GetCapturedStdout(), StrEq("background\n"));
+	EXPECT_THAT(internal::GetCapturedStderr(),
+		    HasSubstr("1 background lint runs, 0 failed"));
+	EXPECT_THAT(unlink(path), Eq(0));
+	EXPECT_THAT(rmdir(dir), Eq(0));
+}
+
+static int count_call(int *calls)
+{
+	return ++*calls;
+}
+
+TEST(Logging, NotLoggedIsNotEvaluated)
+{
+	enum severity const old_severity = set_severity_ceiling(LCI_SEV_DEBUG);
+	int calls = 0;
+
+	ASSERT_FALSE(is_severity_logged(LCI_SEV_EMERGENCY));
+	(void)log_printf(LCI_SEV_DEBUG, ("%d\n", count_call(&calls)));
+	log_puts(LCI_SEV_ERROR, count_call(&calls) ? "a\n" : "b\n");
+	EXPECT_THAT(calls, Eq(0));
+
+	(void) set_severity_ceiling(old_severity);
+}
+
+TEST(Output, UnitIsFirstSource)
+{
+	char cc[] = "cc";
+	char c[] = "-c";
+	char o[] = "-o";
+	char obj[] = "x.o";
+	char src[] = "x.c";
+	char *compile[] = { cc, c, o, obj, src, NULL };
+	char *link[] = { cc, o, obj, NULL };
+
+	EXPECT_THAT(output_unit(ARGV_COUNT(compile), compile), StrEq("x.c"));
+	EXPECT_THAT(output_unit(ARGV_COUNT(link), link), StrEq("x.o"));
+	EXPECT_THAT(output_unit(1, link), StrEq("cc"));
+}
+
+/*
+ * Number of runs of lines naming a and b in turn, 2 when the output of
+ * each is one block.  count gets the diagnostics of each.
+ */
+static int unit_runs(std::string const &out, int count[2])
+{
+	std::istringstream lines(out);
+	std::string line;
+	int last = -1;
+	int runs = 0;
+
+	count[0] = count[1] = 0;
+	while (std::getline(lines, line)) {
+		int const unit = (line.find("a.c") != std::string::npos) ? 0 :
+		    (line.find("b.c") != std::string::npos) ? 1 : -1;
+
+		if (-1 == unit)
+			continue;
+		if (line.find("Info 765") != std::string::npos)
+			++count[unit];
+		if (unit != last)
+			++runs;
+		last = unit;
+	}
+	return runs;
+}
+
+TEST(Output, ConcurrentUnitsStayWhole)
+{
+	std::string const dir = temp_dir();
+	char const *const modes[] = { "1", "prefix", "tag" };
+	char const *const compile_a[] = { "lci", "-b", "cc", "-c", "a.c", NULL };
+	char const *const compile_b[] = { "lci", "-b", "cc", "-c", "b.c", NULL };
+	size_t m;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	write_file((dir + "/b.c").c_str(), "int b = 1;\n");
+	for (m = 0; m != sizeof(modes) / sizeof(modes[0]); ++m) {
+		char mode[32];
+		char const *const env[] = { mode, "FAKE_OUTPUT_LINES=5000",
+			NULL
+		};
+		std::string out;
+		int count[2];
+		int fds[2];
+		pid_t a;
+		pid_t b;
+
+		(void)sprintf(mode, "LCI_GROUP_OUTPUT=%s", modes[m]);
+		ASSERT_THAT(pipe(fds), Eq(0));
+		a = start_built(dir, env, compile_a, fds);
+		b = start_built(dir, env, compile_b, fds);
+		(void)close(fds[1]);
+		EXPECT_THAT(child_output(a, fds[0], &out), Eq(0));
+		EXPECT_THAT(waitpid(b, NULL, 0), Eq(b));
+		EXPECT_THAT(unit_runs(out, count), Eq(2)) << modes[m];
+		EXPECT_THAT(count[0], Eq(5000)) << modes[m];
+		EXPECT_THAT(count[1], Eq(5000)) << modes[m];
+	}
+	remove_dir(dir);
+}
+
+TEST(Analyzer, ParseTranslateCombine)
+{
+	struct analyzer list[MAX_ANALYZERS];
+	char cc[] = "cc";
+	char c[] = "-c";
+	char inc[] = "-Iinc";
+	char def[] = "-D";
+	char name[] = "N";
+	char wall[] = "-Wall";
+	char o[] = "-o";
+	char obj[] = "x.o";
+	char src[] = "x.c";
+	char *compile[] = { cc, c, inc, def, name, wall, o, obj, src, NULL };
+	char **vec;
+	int const codes[] = { 2, 0, 1 };
+
+	ASSERT_THAT(parse_analyzers("lint cppcheck:cppcheck:2,clang-tidy:tidy"
+				    " bad:style", list), Eq(3));
+	EXPECT_THAT(list[0].style, Eq(ANALYZER_LINT));
+	EXPECT_THAT(list[1].program, StrEq("cppcheck"));
+	EXPECT_THAT(list[1].jobs, Eq(2));
+	EXPECT_THAT(list[2].style, Eq(ANALYZER_TIDY));
+
+	vec = analyzer_args(list[1].program, list[1].style,
+			    ARGV_COUNT(compile), compile);
+	EXPECT_THAT(vec[1], StrEq("-Iinc"));
+	EXPECT_THAT(vec[3], StrEq("N"));
+	EXPECT_THAT(vec[4], StrEq("x.c"));
+	EXPECT_THAT(vec[5], IsNull());
+	free(vec);
+	vec = analyzer_args(list[2].program, list[2].style,
+			    ARGV_COUNT(compile), compile);
+	EXPECT_THAT(vec[1], StrEq("x.c"));
+	EXPECT_THAT(vec[2], StrEq("--"));
+	EXPECT_THAT(vec[6], StrEq("-Wall"));
+	EXPECT_THAT(vec[7], IsNull());
+	free(vec);
+
+	EXPECT_THAT(combine_exit_codes(POLICY_WORST, codes, 3), Eq(2));
+	EXPECT_THAT(combine_exit_codes(POLICY_FIRST, codes, 3), Eq(2));
+	EXPECT_THAT(combine_exit_codes(POLICY_ALL, codes, 3), Eq(0));
+}
+
+/*
+ * Whether the slot lock file in dir is free, it is left locked if so
+ */
+static int take_free_slot(std::string const &path, int *fd)
+{
+	*fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	return *fd != -1 && flock(*fd, LOCK_EX | LOCK_NB) == 0;
+}
+
+/*
+ * The private directory in dir, as TMPDIR, that lci keeps the analyzer
+ * slots in
+ */
+static std::string slot_dir(std::string const &dir)
+{
+	char name[32];
+
+	(void)sprintf(name, "/lci-%lu", (unsigned long)getuid());
+	(void)mkdir((dir + name).c_str(), 0700);
+	return dir + name;
+}
+
+/*
+ * lci waits for the slot of fake-lint-nt.exe, which the test holds,
+ * without holding the one fake-flint ran in
+ */
+TEST(Analyzer, WaitsHoldingNoSlot)
+{
+	std::string const dir = temp_dir();
+	std::string const tmpdir = "TMPDIR=" + dir;
+	char const *const env[] = { tmpdir.c_str(),
+		"LCI_ANALYZERS=fake-flint:lint:1 fake-lint-nt.exe:lint:1", NULL
+	};
+	char const *const argv[] = { "lci", "-b", "cc", "-c", "a.c", NULL };
+	std::string out;
+	int held;
+	int flint;
+	int fds[2];
+	pid_t pid;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	ASSERT_TRUE(take_free_slot(slot_dir(dir) + "/fake-lint-nt.exe.0.lock",
+				   &held));
+	ASSERT_THAT(pipe(fds), Eq(0));
+	pid = start_built(dir, env, argv, fds);
+	(void)close(fds[1]);
+	(void)sleep(1);
+	EXPECT_TRUE(take_free_slot(slot_dir(dir) + "/fake-flint.0.lock",
+				   &flint));
+	(void)close(flint);
+	(void)close(held);
+	EXPECT_THAT(child_output(pid, fds[0], &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("This is `fake-flint'"));
+	EXPECT_THAT(out, HasSubstr("This is `fake-lint-nt.exe'"));
+	remove_dir(dir);
+}
+
+/*
+ * fake-flint finds its slots busy and is left to run after
+ * fake-lint-nt.exe.  A slot given back meanwhile is taken, even if it is
+ * not the one the pid of lci picks to wait for.
+ */
+TEST(Analyzer, WaitTakesFreedSlot)
+{
+	std::string const dir = temp_dir();
+	std::string const slots = slot_dir(dir);
+	std::string const tmpdir = "TMPDIR=" + dir;
+	char const *const env[] = { tmpdir.c_str(),
+		"LCI_ANALYZERS=fake-lint-nt.exe:lint:1 fake-flint:lint:4",
+		"FAKE_LATENCY_MS=1000", NULL
+	};
+	char const *const argv[] = { "lci", "-b", "cc", "-c", "a.c", NULL };
+	char name[32];
+	int held[4];
+	int fds[2];
+	int status = -1;
+	int tries;
+	int i;
+	pid_t pid;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	for (i = 0; i != 4; ++i) {
+		(void)sprintf(name, "/fake-flint.%d.lock", i);
+		ASSERT_TRUE(take_free_slot(slots + name, &held[i]));
+	}
+	fds[0] = -1;
+	fds[1] = open("/dev/null", O_WRONLY);
+	pid = start_built(dir, env, argv, fds);
+	(void)close(fds[1]);
+	(void)usleep(300000);
+	i = (int)((pid + 1) % 4);
+	(void)close(held[i]);
+	held[i] = -1;
+	for (tries = 0; tries != 100; ++tries) {
+		(void)usleep(50000);
+		if (waitpid(pid, &status, WNOHANG) == pid)
+			break;
+	}
+	EXPECT_THAT(tries, Ne(100));
+	EXPECT_TRUE(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+	for (i = 0; i != 4; ++i)
+		if (held[i] != -1)
+			(void)close(held[i]);
+	if (100 == tries)
+		(void)waitpid(pid, NULL, 0);
+	remove_dir(dir);
+}
+
+/*
+ * A lock file planted as a symbolic link is not followed
+ */
+TEST(Analyzer, SlotLinkNotFollowed)
+{
+	std::string const dir = temp_dir();
+	std::string const tmpdir = "TMPDIR=" + dir;
+	char const *const env[] = { tmpdir.c_str(),
+		"LCI_ANALYZERS=fake-flint:lint:1", NULL
+	};
+	char const *const argv[] = { "lci", "-b", "cc", "-c", "a.c", NULL };
+	std::string out;
+	struct stat st;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	ASSERT_THAT(symlink((dir + "/target").c_str(),
+			    (slot_dir(dir) + "/fake-flint.0.lock").c_str()),
+		    Eq(0));
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	EXPECT_THAT(out, HasSubstr("This is `fake-flint'"));
+	EXPECT_THAT(lstat((dir + "/target").c_str(), &st), Eq(-1));
+	remove_dir(dir);
+}
+
+/*
+ * Analyzers besides the first need a jobserver token to run at once,
+ * without one they run in turn.  The token is given back.
+ */
+TEST(Analyzer, JobserverTokens)
+{
+	std::string const dir = temp_dir();
+	std::string const script =
+	    "#!/bin/sh\n"
+	    "mkdir " + dir + "/running 2>/dev/null || echo overlap\n"
+	    "sleep 0.3\n"
+	    "rmdir " + dir + "/running 2>/dev/null\n"
+	    "exit 0\n";
+	std::string const analyzers = "LCI_ANALYZERS=" + dir + "/one.sh:lint " +
+	    dir + "/two.sh:lint";
+	char makeflags[64];
+	char const *const env[] = { analyzers.c_str(), makeflags, NULL };
+	char const *const argv[] = { "lci", "-b", "cc", "-c", "a.c", NULL };
+	std::string out;
+	char tokens[4];
+	int fds[2];
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	write_file((dir + "/one.sh").c_str(), script.c_str());
+	write_file((dir + "/two.sh").c_str(), script.c_str());
+	ASSERT_THAT(chmod((dir + "/one.sh").c_str(), 0755), Eq(0));
+	ASSERT_THAT(chmod((dir + "/two.sh").c_str(), 0755), Eq(0));
+	ASSERT_THAT(pipe(fds), Eq(0));
+	(void)sprintf(makeflags, "MAKEFLAGS=-j2 --jobserver-auth=%d,%d",
+		      fds[0], fds[1]);
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	EXPECT_THAT(out, Not(HasSubstr("overlap")));
+	ASSERT_THAT(write(fds[1], "+", 1u), Eq(1));
+	EXPECT_THAT(run_built(dir, env, argv, &out), Eq(0));
+	(void)close(fds[1]);
+	EXPECT_THAT(read(fds[0], tokens, sizeof(tokens)), Eq(1));
+	(void)close(fds[0]);
+	remove_dir(dir);
+}
+
+/*
+ * lci taking the slots in opposite orders all finish
+ */
+TEST(Analyzer, ConcurrentRunsFinish)
+{
+	std::string const dir = temp_dir();
+	std::string const tmpdir = "TMPDIR=" + dir;
+	char const *const specs[] = {
+		"LCI_ANALYZERS=fake-flint:lint:1 fake-lint-nt.exe:lint:1",
+		"LCI_ANALYZERS=fake-lint-nt.exe:lint:1 fake-flint:lint:1"
+	};
+	char const *const argv[] = { "lci", "-b", "cc", "-c", "a.c", NULL };
+	pid_t pids[6];
+	int fds[2];
+	int left = 6;
+	int tries;
+	int i;
+
+	write_file((dir + "/a.c").c_str(), "int a = 1;\n");
+	fds[1] = open((dir + "/out").c_str(), O_WRONLY | O_CREAT, 0666);
+	ASSERT_THAT(fds[1], Ne(-1));
+	for (i = 0; i != 6; ++i) {
+		char const *const env[] = { tmpdir.c_str(), specs[i % 2],
+			"FAKE_LATENCY_MS=200", NULL
+		};
+
+		fds[0] = dup(fds[1]);
+		pids[i] = start_built(dir, env, argv, fds);
+		(void)close(fds[0]);
+	}
+	(void)close(fds[1]);
+	for (tries = 0; tries != 300 && left != 0; ++tries) {
+		(void)usleep(100000);
+		for (i = 0; i != 6; ++i) {
+			int status;
+
+			if (pids[i] != -1 &&
+			    waitpid(pids[i], &status, WNOHANG) == pids[i]) {
+				EXPECT_TRUE(WIFEXITED(status) &&
+					    0 == WEXITSTATUS(status));
+				pids[i] = -1;
+				--left;
+			}
+		}
+	}
+	EXPECT_THAT(left, Eq(0));
+	for (i = 0; i != 6; ++i)
+		if (pids[i] != -1) {
+			(void)kill(pids[i], SIGKILL);
+			(void)waitpid(pids[i], NULL, 0);
+		}
+	remove_dir(dir);
+}
+
 TEST(LciMain, A)
 {
 
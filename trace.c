@@ -0,0 +1,294 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "trace.h"
+#include "util.h"
+
+#define TRACE_MAGIC "LT2"
+#define RECORD_FORMAT \
+	TRACE_MAGIC " %ld %ld %c %s %ld.%06ld %lu %lu %lu %ld %d %s\n"
+#define SCAN_FORMAT \
+	TRACE_MAGIC " %ld %ld %c %63s %ld.%ld %lu %lu %lu %ld %d %1023s"
+
+/*
+ * Children of one lci running at the same time
+ */
+#define MAX_TRACED 16
+/*
+ * lint and the analyzers run instead of it
+ */
+#define MAX_LINT_PROGRAMS 16
+
+struct traced_child {
+	pid_t pid;
+	struct timespec start;
+	char role;
+	char name[64];
+};
+
+static struct traced_child traced[MAX_TRACED];
+static struct timespec lci_start;
+static pid_t lci_pid;
+static char const *lint_programs[MAX_LINT_PROGRAMS];
+static char unit[1024] = "-";
+
+char const *trace_path(void)
+{
+	char const *path = getenv("LCI_TRACE");
+	return (path != NULL && *path != '\0') ? path : NULL;
+}
+
+static unsigned long tv_us(struct timeval const *tv)
+{
+	return (unsigned long)tv->tv_sec * 1000000UL +
+	    (unsigned long)tv->tv_usec;
+}
+
+static unsigned long elapsed_us(struct timespec const *start)
+{
+	struct timespec now;
+
+	(void)clock_gettime(CLOCK_REALTIME, &now);
+	return (unsigned long)((now.tv_sec - start->tv_sec) * 1000000L +
+			       (now.tv_nsec - start->tv_nsec) / 1000L);
+}
+
+/*
+ * A record is one write to a file opened for appending, so records of
+ * parallel lci runs do not mix
+ */
+static void append_record(pid_t pid, int role, char const *name,
+			  struct timespec const *start,
+			  struct rusage const *usage, int code)
+{
+	char line[1536];
+	char const *const path = trace_path();
+	int len;
+	int fd;
+
+	len = sprintf(line, RECORD_FORMAT, (long)lci_pid, (long)pid, role,
+		      name, (long)start->tv_sec, start->tv_nsec / 1000L,
+		      elapsed_us(start), tv_us(&usage->ru_utime),
+		      tv_us(&usage->ru_stime), (long)usage->ru_maxrss, code,
+		      unit);
+	fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+	if (-1 == fd || write(fd, line, (size_t)len) != len)
+		log_printf(LCI_SEV_WARNING, ("cannot trace to %s: %s\n", path,
+			   strerror(errno)));
+	if (fd != -1)
+		(void)close(fd);
+}
+
+/*
+ * A child forked to lint in the background exits too, lci is accounted
+ * once, by the process that started
+ */
+static void trace_self(void)
+{
+	struct rusage usage;
+
+	if (getpid() == lci_pid && getrusage(RUSAGE_SELF, &usage) == 0)
+		append_record(getpid(), TRACE_LCI, TOOL_NAME, &lci_start,
+			      &usage, -1);
+}
+
+/*
+ * White space would split the field
+ */
+static void sanitize(char *field)
+{
+	for (; *field != '\0'; ++field)
+		if (' ' == *field || '\t' == *field || '\n' == *field ||
+		    '"' == *field || '\\' == *field)
+			*field = '_';
+}
+
+/*
+ * The translation unit of the records is the first source file, made
+ * absolute
+ */
+static void set_unit(int argc, char *argv[])
+{
+	char cwd[512];
+	int i;
+
+	for (i = 1; i < argc; ++i)
+		if (is_source_file(argv[i]))
+			break;
+	if (i >= argc)
+		return;
+	if ('/' == argv[i][0] || getcwd(cwd, sizeof(cwd)) == NULL)
+		cwd[0] = '\0';
+	else
+		(void)strcat(cwd, "/");
+	if (strlen(cwd) + strlen(argv[i]) >= sizeof(unit))
+		return;
+	(void)sprintf(unit, "%s%s", cwd, argv[i]);
+	sanitize(unit);
+}
+
+/*
+ * lci itself is traced when it exits, not when it becomes the compiler or
+ * lint with exec.  argv is the compiler command line.
+ */
+void trace_begin(char const *lint, int argc, char *argv[])
+{
+	if (NULL == trace_path())
+		return;
+	(void)clock_gettime(CLOCK_REALTIME, &lci_start);
+	lci_pid = getpid();
+	lint_programs[0] = lint;
+	set_unit(argc, &argv[0]);
+	(void)atexit(trace_self);
+}
+
+/*
+ * name is accounted as lint too, like the analyzers run instead of it
+ */
+void trace_lint_program(char const *name)
+{
+	int i;
+
+	for (i = 0; i != MAX_LINT_PROGRAMS; ++i)
+		if (NULL == lint_programs[i]) {
+			lint_programs[i] = name;
+			return;
+		}
+}
+
+static int is_lint_program(char const *name)
+{
+	int i;
+
+	for (i = 0; i != MAX_LINT_PROGRAMS && lint_programs[i] != NULL; ++i)
+		if (strcmp(name, lint_programs[i]) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ * Only the children of an lci run are traced, the lint of a lint server
+ * is accounted by the lci that relayed it
+ */
+void trace_started(pid_t pid, char const *name)
+{
+	char const *slash = strrchr(name, '/');
+	int i;
+
+	if (0 == lci_pid)
+		return;
+	for (i = 0; i != MAX_TRACED; ++i)
+		if (0 == traced[i].pid)
+			break;
+	if (MAX_TRACED == i)
+		return;
+	traced[i].pid = pid;
+	(void)clock_gettime(CLOCK_REALTIME, &traced[i].start);
+	(void)strncpy(traced[i].name, (NULL == slash) ? name : slash + 1,
+		      sizeof(traced[i].name) - 1u);
+	traced[i].name[sizeof(traced[i].name) - 1u] = '\0';
+	sanitize(traced[i].name);
+	traced[i].role = is_lint_program(name) ? TRACE_LINT : TRACE_COMPILER;
+}
+
+void trace_role(pid_t pid, enum trace_role role)
+{
+	int i;
+
+	for (i = 0; i != MAX_TRACED; ++i)
+		if (traced[i].pid == pid && pid != 0)
+			traced[i].role = (char)role;
+}
+
+void trace_finished(pid_t pid, int status, struct rusage const *usage)
+{
+	int code = EXIT_FAILURE;
+	int i;
+
+	for (i = 0; i != MAX_TRACED; ++i)
+		if (traced[i].pid == pid && pid != 0)
+			break;
+	if (MAX_TRACED == i)
+		return;
+	if (WIFEXITED(status))
+		code = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		code = WTERMSIG(status);
+	append_record(pid, traced[i].role, traced[i].name, &traced[i].start,
+		      usage, code);
+	traced[i].pid = 0;
+}
+
+int trace_parse(char const *line, struct trace_record *rec)
+{
+	return sscanf(line, SCAN_FORMAT, &rec->lci_pid, &rec->pid, &rec->role,
+		      rec->name, &rec->start_sec, &rec->start_usec, &rec->wall_us,
+		      &rec->user_us, &rec->sys_us, &rec->maxrss_kb, &rec->code,
+		      rec->unit) == 12;
+}
+
+/*
+ * Chrome trace event format, one complete event per record with the lci
+ * process as pid and the child as thread
+ */
+int trace_to_json(char const *path, FILE * out)
+{
+	struct trace_record rec;
+	char line[1536];
+	char const *sep = "";
+	FILE *in;
+
+	in = fopen(path, "r");
+	if (NULL == in) {
+		fprintf(stderr, TOOL_NAME ": %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	(void)fputs("{\"traceEvents\":[", out);
+	while (fgets(line, sizeof(line), in) != NULL) {
+		if (!trace_parse(line, &rec))
+			continue;
+		fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,"
+			"\"tid\":%ld,\"ts\":%ld%06ld,\"dur\":%lu,\"args\":{"
+			"\"user_us\":%lu,\"sys_us\":%lu,\"maxrss_kb\":%ld,"
+			"\"exit\":%d,\"unit\":\"%s\"}}", sep, rec.name,
+			rec.lci_pid, rec.pid, rec.start_sec, rec.start_usec,
+			rec.wall_us, rec.user_us, rec.sys_us, rec.maxrss_kb,
+			rec.code, rec.unit);
+		sep = ",";
+	}
+	(void)fputs("\n],\"displayTimeUnit\":\"ms\"}\n", out);
+	(void)fclose(in);
+	return (fflush(out) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
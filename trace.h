@@ -0,0 +1,65 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_TRACE_H_
+#define LCI_INC_TRACE_H_
+#else
+#error "LCI_INC_TRACE_H_"
+#endif
+
+/*
+ * Resource accounting.  With LCI_TRACE naming a file, lci appends one line
+ * per child it waited for and one for itself, giving the role, start, wall
+ * time, user and system CPU time, peak RSS, exit code (-1 for lci) and the
+ * translation unit.  The preprocessor run for the lint cache has a role of
+ * its own.  Lint relayed to a lint server or remote worker is accounted by
+ * the relaying child, the CPU time of lint is spent elsewhere then.
+ */
+
+enum trace_role {
+	TRACE_LCI = 'S',
+	TRACE_COMPILER = 'C',
+	TRACE_LINT = 'L',
+	TRACE_PREPROCESSOR = 'P'
+};
+
+struct rusage;
+
+struct trace_record {
+	long lci_pid;
+	long pid;
+	char role;
+	char name[64];
+	long start_sec;
+	long start_usec;
+	unsigned long wall_us;
+	unsigned long user_us;
+	unsigned long sys_us;
+	long maxrss_kb;
+	int code;
+	char unit[1024];
+};
+
+extern char const *trace_path(void);
+extern void trace_begin(char const *lint, int argc, char *argv[]);
+extern void trace_lint_program(char const *name);
+extern void trace_started(pid_t pid, char const *name);
+extern void trace_role(pid_t pid, enum trace_role role);
+extern void trace_finished(pid_t pid, int status, struct rusage const *usage);
+extern int trace_parse(char const *line, struct trace_record *rec);
+extern int trace_to_json(char const *path, FILE * out);
@@ -16,30 +16,168 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
 #include "util.h"
 
+#define LOG_RING_SIZE (64u * 1024u)
+
 static enum severity severity_ceiling_ = LCI_SEV_NOTICE;
-static FILE *log_stream_ = NULL;
+static int log_fd_ = -1;
+static long log_pid_ = 0;
+
+/*
+ * Records from log_tail_ up to log_head_, wrapping at the end
+ */
+static char log_ring_[LOG_RING_SIZE];
+static size_t log_head_ = 0;
+static size_t log_tail_ = 0;
+static size_t log_used_ = 0;
+
+int log_threshold_ = -1;
 
 int (*stream_format_output) (FILE * stream, char const *format, ...) = fprintf;
 
+static void out_of_memory(void)
+{
+	log_puts(LCI_SEV_ALERT, "out-of-memory\n");
+	fputs(TOOL_NAME ": out-of-memory\n", stderr);
+	exit(EXIT_FAILURE);
+}
+
+void *xmalloc(size_t size)
+{
+	void *p = malloc(size);
+	if (NULL == p)
+		out_of_memory();
+	return p;
+}
+
+void *xrealloc(void *ptr, size_t size)
+{
+	void *p = realloc(ptr, size);
+	if (NULL == p)
+		out_of_memory();
+	return p;
+}
+
 char *xstrdup(char const *str)
 {
-	char *dup = (char *)malloc(strlen(str) + 1u);
-	if (NULL == dup) {
-		log_puts(LCI_SEV_ALERT, "out-of-memory\n");
-		fputs(TOOL_NAME ": out-of-memory\n", stderr);
-		exit(EXIT_FAILURE);
-	}
+	char *dup = (char *)xmalloc(strlen(str) + 1u);
 	(void)strcpy(dup, str);
 	return dup;
 }
 
-int log_printf(enum severity severity, char const *format, ...)
+char *xjoin_path(char const *dir, char const *name)
+{
+	size_t const len = strlen(dir);
+	char *path = (char *)xmalloc(len + 1u + strlen(name) + 1u);
+	(void)strcpy(path, dir);
+	path[len] = '/';
+	(void)strcpy(&path[len + 1u], name);
+	return path;
+}
+
+/*
+ * TMPDIR/lci-uid, for files of lci that other users must not plant or
+ * read.  It is made with mode 0700, an existing one must be a directory
+ * of this user that only it can use.  NULL if it cannot be had.
+ */
+char *user_tmp_dir(void)
+{
+	char const *tmpdir = getenv("TMPDIR");
+	char name[32];
+	struct stat st;
+	char *dir;
+
+	if (NULL == tmpdir || '\0' == *tmpdir)
+		tmpdir = "/tmp";
+	(void)sprintf(name, "lci-%lu", (unsigned long)getuid());
+	dir = xjoin_path(tmpdir, name);
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		log_printf(LCI_SEV_WARNING, ("cannot create %s: %s\n", dir,
+			   strerror(errno)));
+		free(dir);
+		return NULL;
+	}
+	if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) ||
+	    st.st_uid != getuid() || (st.st_mode & 077) != 0) {
+		log_printf(LCI_SEV_WARNING, ("%s is not a private directory\n",
+			   dir));
+		free(dir);
+		return NULL;
+	}
+	return dir;
+}
+
+static void ring_put(void const *data, size_t len)
+{
+	size_t const first = (len < LOG_RING_SIZE - log_head_) ?
+	    len : LOG_RING_SIZE - log_head_;
+
+	memcpy(&log_ring_[log_head_], data, first);
+	memcpy(log_ring_, (char const *)data + first, len - first);
+	log_head_ = (log_head_ + len) % LOG_RING_SIZE;
+	log_used_ += len;
+}
+
+/*
+ * Appends the records in one write, so records of processes logging to
+ * the same file do not interleave
+ */
+void log_flush(void)
+{
+	struct iovec iov[2];
+	int count = 1;
+
+	if (0 == log_used_ || -1 == log_fd_)
+		return;
+	iov[0].iov_base = &log_ring_[log_tail_];
+	if (log_tail_ < log_head_) {
+		iov[0].iov_len = log_head_ - log_tail_;
+	} else {
+		iov[0].iov_len = LOG_RING_SIZE - log_tail_;
+		iov[1].iov_base = log_ring_;
+		iov[1].iov_len = log_head_;
+		count = 2;
+	}
+	(void)writev(log_fd_, iov, count);
+	log_head_ = log_tail_ = log_used_ = 0;
+}
+
+static void log_record(enum severity severity, char const *text, size_t len)
+{
+	struct log_record rec;
+	struct timespec now;
+
+	if (len > LOG_MAX_TEXT)
+		len = LOG_MAX_TEXT;
+	if (log_used_ + sizeof(rec) + len > LOG_RING_SIZE)
+		log_flush();
+	(void)clock_gettime(CLOCK_REALTIME, &now);
+	rec.magic = LOG_RECORD_MAGIC;
+	rec.severity = (unsigned short)severity;
+	rec.len = (unsigned short)len;
+	rec.reserved = 0;
+	rec.pid = log_pid_;
+	rec.sec = (long)now.tv_sec;
+	rec.nsec = now.tv_nsec;
+	ring_put(&rec, sizeof(rec));
+	ring_put(text, len);
+}
+
+int (log_printf)(enum severity severity, char const *format, ...)
 {
 	int ret;
 	va_list ap;
@@ -50,24 +188,80 @@ int log_printf(enum severity severity, char const *format, ...)
 	return ret;
 }
 
+/*
+ * The record of log_printf, at the severity it set last
+ */
+enum severity log_severity_ = LCI_SEV_DEBUG;
+
+int log_format_(char const *format, ...)
+{
+	int ret;
+	va_list ap;
+
+	va_start(ap, format);
+	ret = log_vprintf(log_severity_, format, ap);
+	va_end(ap);
+	return ret;
+}
+
 int log_vprintf(enum severity severity, char const *format, va_list args)
 {
-	if (is_severity_logged(severity))
-		if (log_stream_ != NULL)
-			return vfprintf(log_stream_, format, args);
-	return 0;
+	char text[LOG_MAX_TEXT + 1];
+	int len;
+
+	if (!is_severity_logged(severity))
+		return 0;
+	len = vsnprintf(text, sizeof(text), format, args);
+	if (len < 0)
+		return len;
+	log_record(severity, text, strlen(text));
+	return len;
 }
 
-void log_puts(enum severity severity, char const *message)
+void (log_puts)(enum severity severity, char const *message)
 {
 	if (is_severity_logged(severity))
-		if (log_stream_ != NULL)
-			(void)fputs(message, log_stream_);
+		log_record(severity, message, strlen(message));
 }
 
 int is_severity_logged(enum severity severity)
 {
-	return (severity & 0xF) <= severity_ceiling_;
+	return (int)(severity & 0xF) <= log_threshold_;
+}
+
+static void update_threshold(void)
+{
+	log_threshold_ = (-1 == log_fd_) ? -1 : (int)severity_ceiling_;
+}
+
+/*
+ * Opens LCI_LOG, lci and its tools log nothing until they call this
+ */
+void log_begin(void)
+{
+	char const *const path = getenv("LCI_LOG");
+	char const *const level = getenv("LCI_LOG_LEVEL");
+
+	if (log_fd_ != -1 || NULL == path || '\0' == *path)
+		return;
+	log_fd_ = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+	if (-1 == log_fd_)
+		return;
+	(void)fcntl(log_fd_, F_SETFD, FD_CLOEXEC);
+	log_pid_ = (long)getpid();
+	if (level != NULL && *level >= '0' && *level <= '7')
+		severity_ceiling_ = (enum severity)(*level - '0');
+	update_threshold();
+	(void)atexit(log_flush);
+}
+
+/*
+ * The records of the parent are the parent's to write
+ */
+void log_forked(void)
+{
+	log_head_ = log_tail_ = log_used_ = 0;
+	log_pid_ = (long)getpid();
 }
 
 enum severity get_severity_ceiling(void)
@@ -79,6 +273,7 @@ enum severity set_severity_ceiling(enum severity ceiling)
 {
 	enum severity r = severity_ceiling_;
 	severity_ceiling_ = ceiling;
+	update_threshold();
 	return r;
 }
 
@@ -35,14 +35,70 @@ enum severity {
 	LCI_SEV_DEBUG		/*!< debug-level messages */
 };
 
+/*
+ * Log records go to the file named by LCI_LOG, up to the severity ceiling,
+ * LCI_LOG_LEVEL or notice, raised by --verbose.  Records are kept in a
+ * buffer of binary records that is appended to the file in one write at
+ * exit, when full and by log_flush, lci-log prints them.
+ */
+
+#define LOG_RECORD_MAGIC 0x4c43u
+#define LOG_MAX_TEXT 1024
+
+/*
+ * A record in the log file, native byte order, followed by len bytes of
+ * text without NUL
+ */
+struct log_record {
+	unsigned short magic;
+	unsigned short severity;
+	unsigned short len;
+	unsigned short reserved;
+	long pid;
+	long sec;
+	long nsec;
+};
+
+/*
+ * Least severe severity that is logged, -1 when nothing is
+ */
+extern int log_threshold_;
+
 extern enum severity get_severity_ceiling(void);
 extern enum severity set_severity_ceiling(enum severity ceiling);
 extern int is_severity_logged(enum severity severity);
 extern void inc_severity_ceiling(void);
 extern int log_printf(enum severity severity, char const *format, ...);
+extern enum severity log_severity_;
+extern int log_format_(char const *format, ...);
 extern int log_vprintf(enum severity severity, char const *format,
 		       va_list args);
 extern void log_puts(enum severity severity, char const *message);
+extern void log_begin(void);
+extern void log_flush(void);
+extern void log_forked(void);
+
+/*
+ * Records less severe than LCI_LOG_FLOOR are compiled out, the arguments
+ * of a record that is not logged are not evaluated.  C89 has no variadic
+ * macros, so log_printf takes the format and its arguments in parentheses
+ * of their own: log_printf(LCI_SEV_DEBUG, ("%d\n", n)).
+ */
+#ifndef LCI_LOG_FLOOR
+#define LCI_LOG_FLOOR LCI_SEV_DEBUG
+#endif
+
+#define LCI_LOGGED(severity) \
+	((severity) <= LCI_LOG_FLOOR && (int)(severity) <= log_threshold_)
+#define log_printf(severity, args) \
+	(LCI_LOGGED(severity) ? \
+	 (log_severity_ = (severity), log_format_ args) : 0)
+#define log_puts(severity, message) \
+	(LCI_LOGGED(severity) ? (log_puts)(severity, message) : (void)0)
 
 extern int (*stream_format_output) (FILE * stream, char const *format, ...);
+extern void *xmalloc(size_t size);
+extern void *xrealloc(void *ptr, size_t size);
 extern char *xstrdup(char const *s);
+extern char *xjoin_path(char const *dir, char const *name);
+extern char *user_tmp_dir(void);
@@ -0,0 +1,166 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "wire.h"
+
+static int write_all(int fd, void const *data, size_t len)
+{
+	char const *p = (char const *)data;
+
+	while (len != 0) {
+		ssize_t const n = write(fd, p, len);
+		if (-1 == n) {
+			if (EINTR == errno)
+				continue;
+			return 0;
+		}
+		p += n;
+		len -= (size_t) n;
+	}
+	return 1;
+}
+
+static int read_all(int fd, void *data, size_t len)
+{
+	char *p = (char *)data;
+
+	while (len != 0) {
+		ssize_t const n = read(fd, p, len);
+		if (n <= 0) {
+			if (-1 == n && EINTR == errno)
+				continue;
+			return 0;
+		}
+		p += n;
+		len -= (size_t) n;
+	}
+	return 1;
+}
+
+int wire_send(int fd, int type, void const *data, size_t len)
+{
+	unsigned char header[5];
+
+	header[0] = (unsigned char)type;
+	header[1] = (unsigned char)(len >> 24);
+	header[2] = (unsigned char)(len >> 16);
+	header[3] = (unsigned char)(len >> 8);
+	header[4] = (unsigned char)len;
+	return write_all(fd, header, sizeof(header)) &&
+	    write_all(fd, data, len);
+}
+
+/*
+ * Returns 0 on end of stream, errors and oversized frames
+ */
+int wire_recv(int fd, int *type, struct wire_buf *buf)
+{
+	unsigned char header[5];
+	unsigned long len;
+
+	if (!read_all(fd, header, sizeof(header)))
+		return 0;
+	len = ((unsigned long)header[1] << 24) |
+	    ((unsigned long)header[2] << 16) |
+	    ((unsigned long)header[3] << 8) | (unsigned long)header[4];
+	if (len > WIRE_MAX_PAYLOAD)
+		return 0;
+	if (len + 1u > buf->size) {
+		buf->size = (size_t) len + 1u;
+		buf->data = (char *)xrealloc(buf->data, buf->size);
+	}
+	if (!read_all(fd, buf->data, (size_t) len))
+		return 0;
+	/*
+	 * terminated for the convenience of text payloads
+	 */
+	buf->data[len] = '\0';
+	buf->len = (size_t) len;
+	*type = header[0];
+	return 1;
+}
+
+static void append(struct wire_buf *buf, char const *str)
+{
+	size_t const len = strlen(str) + 1u;
+
+	if (buf->len + len > buf->size) {
+		buf->size = 2u * (buf->len + len);
+		buf->data = (char *)xrealloc(buf->data, buf->size);
+	}
+	memcpy(&buf->data[buf->len], str, len);
+	buf->len += len;
+}
+
+void wire_pack_argv(struct wire_buf *buf, char const *cwd, char *argv[])
+{
+	int i;
+
+	buf->len = 0;
+	append(buf, cwd);
+	for (i = 0; argv[i] != NULL; ++i)
+		append(buf, argv[i]);
+}
+
+/*
+ * The returned vector points into buf, NULL for a malformed request
+ */
+char **wire_unpack_argv(struct wire_buf *buf, char **cwd)
+{
+	char **argv;
+	size_t n = 0;
+	size_t i;
+	char *p;
+
+	if (0 == buf->len || buf->data[buf->len - 1u] != '\0')
+		return NULL;
+	for (i = 0; i != buf->len; ++i)
+		if ('\0' == buf->data[i])
+			++n;
+	if (n < 2u)
+		return NULL;
+	argv = (char **)xmalloc(sizeof(char *) * n);
+	*cwd = buf->data;
+	p = buf->data + strlen(buf->data) + 1;
+	for (i = 0; i != n - 1u; ++i) {
+		argv[i] = p;
+		p += strlen(p) + 1;
+	}
+	argv[n - 1u] = NULL;
+	return argv;
+}
+
+void wire_buf_free(struct wire_buf *buf)
+{
+	free(buf->data);
+	buf->data = NULL;
+	buf->len = 0;
+	buf->size = 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LCI_INC_WIRE_H_
+#define LCI_INC_WIRE_H_
+#else
+#error "LCI_INC_WIRE_H_"
+#endif
+
+/*
+ * Framed messages between lci and a lint server or worker, a type byte
+ * and a four byte big endian payload length followed by the payload.  A
+ * worker gets the files of a unit, then the unit, or a load query.
+ */
+
+enum wire_type {
+	WIRE_REQUEST = 'R',	/*!< cwd and argv, NUL terminated */
+	WIRE_FILE = 'F',	/*!< argument naming a file, NUL, content */
+	WIRE_UNIT = 'U',	/*!< like a request, the cwd is not used */
+	WIRE_QUERY = 'Q',	/*!< ask a worker for its load, no payload */
+	WIRE_LOAD = 'L',	/*!< busy and total jobs as decimal text */
+	WIRE_STDOUT = 'O',	/*!< lint stdout data */
+	WIRE_STDERR = 'E',	/*!< lint stderr data */
+	WIRE_EXIT = 'X'		/*!< exit code as decimal text */
+};
+
+#define WIRE_MAX_PAYLOAD (64UL * 1024UL * 1024UL)
+
+struct wire_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+extern int wire_send(int fd, int type, void const *data, size_t len);
+extern int wire_recv(int fd, int *type, struct wire_buf *buf);
+extern void wire_pack_argv(struct wire_buf *buf, char const *cwd,
+			   char *argv[]);
+extern char **wire_unpack_argv(struct wire_buf *buf, char **cwd);
+extern void wire_buf_free(struct wire_buf *buf);
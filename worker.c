@@ -0,0 +1,67 @@
+/*
+ * Lint compiler interceptor
+ * Copyright (C) 2013 Bo Rydberg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * lci-worker, lints units that lci ships over TCP, see LCI_WORKERS.  The
+ * preprocessed source comes with the unit, a worker only needs a lint.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "util.h"
+
+#define WORKER_NAME "lci-worker"
+#define DEFAULT_LINT "fake-flint"
+
+static void print_usage(FILE * stream)
+{
+	fputs("usage: " WORKER_NAME " [-j jobs] [-l lint] [host:]port\n"
+	      "    host       address to listen on, default loopback only\n"
+	      "    -j jobs    lint processes, default CPU count\n"
+	      "    -l lint    lint program, default " DEFAULT_LINT "\n",
+	      stream);
+}
+
+int main(int argc, char *argv[])
+{
+	char const *lint = DEFAULT_LINT;
+	int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int i = 1;
+
+	for (; i + 1 < argc && '-' == argv[i][0]; i += 2) {
+		if (strcmp(argv[i], "-j") == 0) {
+			jobs = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "-l") == 0) {
+			lint = argv[i + 1];
+		} else {
+			break;
+		}
+	}
+	if (i + 1 != argc || '-' == argv[i][0]) {
+		print_usage(stderr);
+		return EXIT_FAILURE;
+	}
+	log_begin();
+	return lint_worker_main(argv[i], jobs, lint);
+}